@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Heap allocations made so far by this process; counted by the operator new
+// replacement in bench_main.cpp.
+size_t allocation_count();
+
+// Keeps the compiler from discarding a result the benchmark does not otherwise use.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+class BenchSuite {
+public:
+    BenchSuite(size_t iterations, std::string filter);
+
+    // Calls `op` once to warm up caches and grow buffers to their steady-state
+    // capacity, then `iterations` times under the clock and allocation counter.
+    // Skipped unless the name contains the filter.
+    template <typename F>
+    void run(const std::string& name, F&& op) {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+        op();
+        size_t allocations_before = allocation_count();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            op();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        size_t allocations = allocation_count() - allocations_before;
+        results.push_back(BenchResult{
+            name,
+            iterations,
+            std::chrono::duration<double, std::nano>(elapsed).count() / iterations,
+            static_cast<double>(allocations) / iterations,
+        });
+    }
+
+    void print_table(std::FILE* out) const;
+    void print_json(std::FILE* out) const;
+
+private:
+    size_t iterations;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+void run_parser_benchmarks(BenchSuite& suite);
+void run_router_benchmarks(BenchSuite& suite);
+void run_response_benchmarks(BenchSuite& suite);
+void run_logger_benchmarks(BenchSuite& suite);
@@ -0,0 +1,82 @@
+#include "bench.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+size_t allocation_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+BenchSuite::BenchSuite(size_t iterations, std::string filter)
+    : iterations(iterations), filter(std::move(filter)) {}
+
+void BenchSuite::print_table(std::FILE* out) const {
+    for (const auto& result : results) {
+        std::fprintf(out, "%-32s %10.1f ns/op %8.3f allocs/op\n",
+                     result.name.c_str(), result.ns_per_op, result.allocs_per_op);
+    }
+}
+
+void BenchSuite::print_json(std::FILE* out) const {
+    // Benchmark names are plain identifiers, so nothing needs escaping.
+    std::fprintf(out, "{\"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        std::fprintf(out, "%s\n  {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.3f}",
+                     i == 0 ? "" : ",", result.name.c_str(), result.iterations, result.ns_per_op, result.allocs_per_op);
+    }
+    std::fprintf(out, "\n]}\n");
+}
+
+// bcpp_bench [--json] [--filter <substring>] [iterations]
+int main(int argc, char** argv) {
+    size_t iterations = 200000;
+    std::string filter;
+    bool json = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            iterations = std::strtoul(argv[i], nullptr, 10);
+        }
+    }
+    if (iterations == 0) {
+        std::fprintf(stderr, "usage: %s [--json] [--filter <substring>] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    BenchSuite suite(iterations, filter);
+    run_parser_benchmarks(suite);
+    run_router_benchmarks(suite);
+    run_response_benchmarks(suite);
+    run_logger_benchmarks(suite);
+    if (json) {
+        suite.print_json(stdout);
+    } else {
+        suite.print_table(stdout);
+    }
+    return 0;
+}
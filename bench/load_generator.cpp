@@ -0,0 +1,765 @@
+#include "../include/http_server.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear histogram of nanoseconds with 128 buckets per power of two, so every
+// value is kept to within 1%. One per client thread, merged after the run.
+class Histogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 7;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BUCKET_BITS;
+
+    Histogram() : counts((64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS, 0) {}
+
+    void record(uint64_t ns) {
+        ++counts[index_of(ns)];
+        ++total;
+        largest = std::max(largest, ns);
+    }
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        largest = std::max(largest, other.largest);
+    }
+    uint64_t count() const { return total; }
+    uint64_t max() const { return largest; }
+    // The largest value of the bucket holding the sample at `quantile`.
+    uint64_t percentile(double quantile) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucket_max(i), largest);
+            }
+        }
+        return largest;
+    }
+
+private:
+    static size_t index_of(uint64_t ns) {
+        if (ns < SUB_BUCKETS) {
+            return ns;
+        }
+        unsigned exponent = static_cast<unsigned>(std::bit_width(ns)) - 1;
+        return ((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + ((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    }
+    static uint64_t bucket_max(size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        unsigned exponent = static_cast<unsigned>(index >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+        uint64_t sub = index & (SUB_BUCKETS - 1);
+        return (uint64_t(1) << exponent) + ((sub + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t largest = 0;
+};
+
+// "METHOD PATH [BODY]"; `{seq}` in the path becomes a per-connection counter, so
+// requests can spread over many URLs.
+struct RequestTemplate {
+    std::string method;
+    std::string path;
+    std::string body;
+};
+
+struct LoadConfig {
+    std::string host = "127.0.0.1";
+    int port = 18090;
+    bool external = false;
+    std::vector<size_t> server_threads;
+    IoBackend io_backend = IoBackend::EPOLL;
+    size_t connections = 64;
+    size_t pipeline = 1;
+    // Requests per second over all connections; 0 runs closed-loop.
+    double rate = 0;
+    double warmup_seconds = 1;
+    double duration_seconds = 10;
+    size_t client_threads = 0;
+    std::vector<RequestTemplate> templates;
+};
+
+struct LoadResult {
+    // From the time each request was due to be sent: with a rate, a request held
+    // back by a slow response still counts the time it waited, which corrects for
+    // coordinated omission. Closed-loop, it equals `service`.
+    Histogram latency;
+    // From the time each request was actually written to the socket.
+    Histogram service;
+    uint64_t completed = 0;
+    // Responses with a 4xx or 5xx status.
+    uint64_t error_responses = 0;
+    // Requests lost to closed connections or unparsable responses.
+    uint64_t failures = 0;
+
+    void merge(const LoadResult& other) {
+        latency.merge(other.latency);
+        service.merge(other.service);
+        completed += other.completed;
+        error_responses += other.error_responses;
+        failures += other.failures;
+    }
+};
+
+RequestTemplate parse_template(std::string_view spec) {
+    RequestTemplate parsed;
+    size_t method_end = spec.find(' ');
+    if (method_end == std::string_view::npos) {
+        throw std::invalid_argument(std::format("request template needs a method and a path: {}", spec));
+    }
+    parsed.method = spec.substr(0, method_end);
+    std::string_view rest = spec.substr(method_end + 1);
+    size_t path_end = rest.find(' ');
+    parsed.path = rest.substr(0, path_end);
+    if (path_end != std::string_view::npos) {
+        parsed.body = rest.substr(path_end + 1);
+    }
+    return parsed;
+}
+
+void render_request(const RequestTemplate& request, const std::string& host, uint64_t seq, std::string& out) {
+    std::string path = request.path;
+    for (size_t at = path.find("{seq}"); at != std::string::npos; at = path.find("{seq}", at)) {
+        std::string number = std::to_string(seq);
+        path.replace(at, 5, number);
+        at += number.size();
+    }
+    out += std::format("{} {} HTTP/1.1\r\nHost: {}\r\n", request.method, path, host);
+    if (!request.body.empty() || request.method == "POST" || request.method == "PUT") {
+        out += std::format("Content-Length: {}\r\n", request.body.size());
+    }
+    out += "\r\n";
+    out += request.body;
+}
+
+bool header_is(std::string_view line, std::string_view name) {
+    if (line.size() <= name.size() || line[name.size()] != ':') {
+        return false;
+    }
+    return std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+}
+
+std::string_view header_value(std::string_view line) {
+    std::string_view value = line.substr(line.find(':') + 1);
+    while (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+    }
+    return value;
+}
+
+// Length of the complete response at the front of `data`, 0 while it is still
+// incomplete, or std::string::npos if it cannot be framed.
+size_t response_length(std::string_view data, bool head_request, int& status) {
+    size_t head_end = data.find("\r\n\r\n");
+    if (head_end == std::string_view::npos) {
+        return 0;
+    }
+    if (data.size() < 12 || data.substr(0, 5) != "HTTP/") {
+        return std::string::npos;
+    }
+    std::from_chars(data.data() + 9, data.data() + 12, status);
+    size_t body_start = head_end + 4;
+    std::optional<size_t> content_length;
+    bool chunked = false;
+    size_t line_start = data.find("\r\n") + 2;
+    while (line_start < head_end) {
+        size_t line_end = data.find("\r\n", line_start);
+        std::string_view line = data.substr(line_start, line_end - line_start);
+        if (header_is(line, "Content-Length")) {
+            size_t length = 0;
+            std::string_view value = header_value(line);
+            std::from_chars(value.data(), value.data() + value.size(), length);
+            content_length = length;
+        } else if (header_is(line, "Transfer-Encoding")) {
+            chunked = header_value(line).find("chunked") != std::string_view::npos;
+        }
+        line_start = line_end + 2;
+    }
+    if (head_request || status == 204 || status == 304) {
+        return body_start;
+    }
+    if (chunked) {
+        size_t at = body_start;
+        while (true) {
+            size_t size_end = data.find("\r\n", at);
+            if (size_end == std::string_view::npos) {
+                return 0;
+            }
+            size_t chunk_size = 0;
+            auto [ptr, ec] = std::from_chars(data.data() + at, data.data() + size_end, chunk_size, 16);
+            if (ec != std::errc()) {
+                return std::string::npos;
+            }
+            at = size_end + 2 + chunk_size + 2;
+            if (at > data.size()) {
+                return 0;
+            }
+            if (chunk_size == 0) {
+                return at;
+            }
+        }
+    }
+    if (!content_length) {
+        return std::string::npos;
+    }
+    return data.size() >= body_start + *content_length ? body_start + *content_length : 0;
+}
+
+struct InFlight {
+    uint64_t due_ns;
+    uint64_t sent_ns;
+    bool head;
+};
+
+struct Client {
+    int fd = -1;
+    std::string out;
+    size_t out_sent = 0;
+    bool writable_wait = false;
+    std::string in;
+    std::deque<InFlight> in_flight;
+    // Open loop: when the next request is due.
+    uint64_t next_due_ns = 0;
+    uint64_t seq = 0;
+    size_t next_template = 0;
+};
+
+class ClientThread {
+public:
+    ClientThread(const LoadConfig& config, const sockaddr_storage& address, socklen_t address_size,
+                 size_t first_connection, size_t connections)
+        : config(config), address(address), address_size(address_size), clients(connections) {
+        host = std::format("{}:{}", config.host, config.port);
+        if (config.rate > 0) {
+            interval_ns = static_cast<uint64_t>(config.connections * 1e9 / config.rate);
+        }
+        // Offsets spread the open-loop schedules of all connections evenly.
+        for (size_t i = 0; i < clients.size(); ++i) {
+            offsets.push_back(interval_ns * (first_connection + i) / config.connections);
+        }
+    }
+
+    void run(uint64_t start_ns) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        measure_from_ns = start_ns + static_cast<uint64_t>(config.warmup_seconds * 1e9);
+        uint64_t end_ns = measure_from_ns + static_cast<uint64_t>(config.duration_seconds * 1e9);
+        for (size_t i = 0; i < clients.size(); ++i) {
+            clients[i].next_due_ns = start_ns + offsets[i];
+            connect_client(i);
+        }
+        // Open loop: wakes the thread when the next request is due; epoll_wait alone
+        // only sleeps in whole milliseconds. steady_clock is CLOCK_MONOTONIC.
+        int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        struct epoll_event timer_event{};
+        timer_event.events = EPOLLIN;
+        timer_event.data.u64 = TIMER_EVENT;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_event);
+        struct epoll_event events[256];
+        uint64_t now = now_ns();
+        while (now < end_ns) {
+            int timeout_ms = 10;
+            if (interval_ns > 0) {
+                uint64_t next_due = end_ns;
+                for (size_t i = 0; i < clients.size(); ++i) {
+                    fill(i, now);
+                    if (clients[i].fd >= 0 && clients[i].in_flight.size() < config.pipeline) {
+                        next_due = std::min(next_due, clients[i].next_due_ns);
+                    }
+                }
+                if (next_due > now) {
+                    struct itimerspec due{};
+                    due.it_value.tv_sec = static_cast<time_t>(next_due / 1000000000);
+                    due.it_value.tv_nsec = static_cast<long>(next_due % 1000000000);
+                    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &due, nullptr);
+                } else {
+                    timeout_ms = 0;
+                }
+            }
+            int count = epoll_wait(epoll_fd, events, 256, timeout_ms);
+            now = now_ns();
+            for (int e = 0; e < count; ++e) {
+                size_t index = events[e].data.u64;
+                if (index == TIMER_EVENT) {
+                    uint64_t expirations;
+                    [[maybe_unused]] ssize_t drained = read(timer_fd, &expirations, sizeof(expirations));
+                    continue;
+                }
+                if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+                    reconnect(index);
+                    continue;
+                }
+                if (events[e].events & EPOLLOUT) {
+                    flush(index);
+                }
+                if (events[e].events & EPOLLIN) {
+                    receive(index, now);
+                }
+            }
+        }
+        close(timer_fd);
+        for (Client& client : clients) {
+            if (client.fd >= 0) {
+                close(client.fd);
+            }
+        }
+        close(epoll_fd);
+    }
+
+    const LoadResult& get_result() const { return result; }
+
+private:
+    static constexpr uint64_t TIMER_EVENT = ~uint64_t(0);
+
+    void connect_client(size_t index) {
+        Client& client = clients[index];
+        client.fd = socket(address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (client.fd < 0 || connect(client.fd, reinterpret_cast<const sockaddr*>(&address), address_size) < 0) {
+            if (client.fd >= 0) {
+                close(client.fd);
+            }
+            client.fd = -1;
+            ++result.failures;
+            return;
+        }
+        int one = 1;
+        setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = index;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client.fd, &event);
+        if (interval_ns == 0) {
+            fill(index, now_ns());
+        }
+    }
+
+    void reconnect(size_t index) {
+        Client& client = clients[index];
+        result.failures += client.in_flight.size();
+        client.in_flight.clear();
+        client.in.clear();
+        client.out.clear();
+        client.out_sent = 0;
+        client.writable_wait = false;
+        if (client.fd >= 0) {
+            close(client.fd);
+        }
+        connect_client(index);
+    }
+
+    // Queues every request that is due, up to the pipelining depth, and sends them.
+    void fill(size_t index, uint64_t now) {
+        Client& client = clients[index];
+        if (client.fd < 0) {
+            return;
+        }
+        bool queued = false;
+        while (client.in_flight.size() < config.pipeline) {
+            uint64_t due = now;
+            if (interval_ns > 0) {
+                if (client.next_due_ns > now) {
+                    break;
+                }
+                // A request that could not go out on time keeps its due time.
+                due = client.next_due_ns;
+                client.next_due_ns += interval_ns;
+            }
+            const RequestTemplate& request = config.templates[client.next_template];
+            client.next_template = (client.next_template + 1) % config.templates.size();
+            render_request(request, host, client.seq++, client.out);
+            client.in_flight.push_back(InFlight{due, now, request.method == "HEAD"});
+            queued = true;
+        }
+        if (queued && !client.writable_wait) {
+            flush(index);
+        }
+    }
+
+    void flush(size_t index) {
+        Client& client = clients[index];
+        while (client.out_sent < client.out.size()) {
+            ssize_t sent = send(client.fd, client.out.data() + client.out_sent, client.out.size() - client.out_sent, MSG_NOSIGNAL);
+            if (sent > 0) {
+                client.out_sent += static_cast<size_t>(sent);
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                reconnect(index);
+                return;
+            }
+        }
+        bool pending = client.out_sent < client.out.size();
+        if (!pending) {
+            client.out.clear();
+            client.out_sent = 0;
+        }
+        if (pending != client.writable_wait) {
+            client.writable_wait = pending;
+            struct epoll_event event{};
+            event.events = pending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.u64 = index;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client.fd, &event);
+        }
+    }
+
+    void receive(size_t index, uint64_t now) {
+        Client& client = clients[index];
+        char buffer[64 * 1024];
+        while (true) {
+            ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                client.in.append(buffer, static_cast<size_t>(received));
+                continue;
+            }
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            reconnect(index);
+            return;
+        }
+        size_t consumed = 0;
+        while (!client.in_flight.empty()) {
+            int status = 0;
+            size_t length = response_length(std::string_view(client.in).substr(consumed), client.in_flight.front().head, status);
+            if (length == std::string::npos) {
+                reconnect(index);
+                return;
+            }
+            if (length == 0) {
+                break;
+            }
+            consumed += length;
+            InFlight done = client.in_flight.front();
+            client.in_flight.pop_front();
+            if (done.due_ns >= measure_from_ns) {
+                result.latency.record(now - done.due_ns);
+                result.service.record(now - done.sent_ns);
+                ++result.completed;
+                if (status >= 400) {
+                    ++result.error_responses;
+                }
+            }
+        }
+        client.in.erase(0, consumed);
+        if (interval_ns == 0) {
+            fill(index, now);
+        }
+    }
+
+    const LoadConfig& config;
+    sockaddr_storage address;
+    socklen_t address_size;
+    std::string host;
+    uint64_t interval_ns = 0;
+    uint64_t measure_from_ns = 0;
+    int epoll_fd = -1;
+    std::vector<Client> clients;
+    std::vector<uint64_t> offsets;
+    LoadResult result;
+};
+
+LoadResult run_load(const LoadConfig& config) {
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* resolved = nullptr;
+    std::string port = std::to_string(config.port);
+    if (getaddrinfo(config.host.c_str(), port.c_str(), &hints, &resolved) != 0 || resolved == nullptr) {
+        throw std::runtime_error(std::format("cannot resolve {}", config.host));
+    }
+    sockaddr_storage address{};
+    socklen_t address_size = resolved->ai_addrlen;
+    std::memcpy(&address, resolved->ai_addr, resolved->ai_addrlen);
+    freeaddrinfo(resolved);
+
+    size_t thread_count = std::min(config.client_threads, config.connections);
+    std::vector<std::unique_ptr<ClientThread>> clients;
+    size_t assigned = 0;
+    for (size_t t = 0; t < thread_count; ++t) {
+        size_t share = config.connections / thread_count + (t < config.connections % thread_count ? 1 : 0);
+        clients.push_back(std::make_unique<ClientThread>(config, address, address_size, assigned, share));
+        assigned += share;
+    }
+    uint64_t start_ns = now_ns();
+    std::vector<std::thread> threads;
+    for (auto& client : clients) {
+        threads.emplace_back([&client, start_ns]() { client->run(start_ns); });
+    }
+    LoadResult total;
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+        total.merge(clients[t]->get_result());
+    }
+    return total;
+}
+
+// Routes answering the default request mix when the server runs in-process.
+void add_load_routes(Router& router) {
+    router.add_route(RequestMethod::GET, "/hello", [](const HttpRequest&) {
+        HttpResponse response;
+        response.set_content_type(MimeType::TextPlain);
+        response.set_body("Hello, World!");
+        return response;
+    });
+    router.add_route(RequestMethod::GET, "/users/{id}", [](const HttpRequest& request) {
+        HttpResponse response;
+        response.set_content_type(MimeType::ApplicationJson);
+        response.set_body(std::format("{{\"id\":\"{}\",\"name\":\"user\",\"active\":true}}",
+                                      request.get_path_param("id").value_or("")));
+        return response;
+    });
+    router.add_route(RequestMethod::POST, "/echo", [](const HttpRequest& request) {
+        HttpResponse response;
+        response.set_content_type(MimeType::ApplicationJson);
+        response.set_body(std::string(request.body));
+        return response;
+    });
+}
+
+bool wait_until_listening(const LoadConfig& config) {
+    for (int attempt = 0; attempt < 200; ++attempt) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(config.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool connected = connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        close(fd);
+        if (connected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+std::string format_duration(uint64_t ns) {
+    if (ns < 1000) {
+        return std::format("{}ns", ns);
+    }
+    if (ns < 1000000) {
+        return std::format("{:.1f}us", ns / 1e3);
+    }
+    if (ns < 1000000000) {
+        return std::format("{:.2f}ms", ns / 1e6);
+    }
+    return std::format("{:.2f}s", ns / 1e9);
+}
+
+void print_result(const LoadConfig& config, const std::string& label, const LoadResult& result) {
+    std::printf("%s: %zu connections, pipeline %zu, %s, %.0fs\n", label.c_str(), config.connections, config.pipeline,
+                config.rate > 0 ? std::format("{:.0f} req/s offered", config.rate).c_str() : "closed loop",
+                config.duration_seconds);
+    std::printf("  %llu requests, %.0f req/s, %llu error responses, %llu failed\n",
+                static_cast<unsigned long long>(result.completed), result.completed / config.duration_seconds,
+                static_cast<unsigned long long>(result.error_responses), static_cast<unsigned long long>(result.failures));
+    auto print_latency = [](const char* name, const Histogram& histogram) {
+        std::printf("  %-8s p50 %-9s p99 %-9s p99.9 %-9s max %s\n", name,
+                    format_duration(histogram.percentile(0.5)).c_str(), format_duration(histogram.percentile(0.99)).c_str(),
+                    format_duration(histogram.percentile(0.999)).c_str(), format_duration(histogram.max()).c_str());
+    };
+    print_latency("latency", result.latency);
+    if (config.rate > 0) {
+        // Without the correction: what a closed-loop tool would have reported.
+        print_latency("service", result.service);
+    }
+}
+
+std::vector<size_t> parse_list(std::string_view text) {
+    std::vector<size_t> values;
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        std::string_view item = text.substr(0, comma);
+        size_t value = 0;
+        std::from_chars(item.data(), item.data() + item.size(), value);
+        if (value > 0) {
+            values.push_back(value);
+        }
+        text.remove_prefix(comma == std::string_view::npos ? text.size() : comma + 1);
+    }
+    return values;
+}
+
+void print_usage(const char* program) {
+    std::fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --target HOST:PORT      load a running server instead of starting one in-process\n"
+        "  --server-threads LIST   event loops of the in-process server, e.g. 1,2,4 (default: all cores)\n"
+        "  --port N                port of the in-process server (default 18090)\n"
+        "  --io-backend NAME       epoll or io_uring for the in-process server (default epoll)\n"
+        "  --connections N         concurrent connections (default 64)\n"
+        "  --pipeline N            requests in flight per connection (default 1)\n"
+        "  --rate N                open loop at N requests/s in total; omitted: closed loop\n"
+        "  --duration SECONDS      measured time per run (default 10)\n"
+        "  --warmup SECONDS        unmeasured time before it (default 1)\n"
+        "  --client-threads N      load generator threads (default: half the cores)\n"
+        "  --request \"METHOD PATH [BODY]\"  request mix, sent round-robin; repeatable;\n"
+        "                          {seq} in PATH is replaced by a counter (default: GET /hello)\n",
+        program);
+}
+
+}
+
+int main(int argc, char** argv) {
+    LoadConfig config;
+    size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    config.client_threads = std::max<size_t>(cores / 2, 1);
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view option = argv[i];
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--target") {
+                size_t colon = value.rfind(':');
+                if (colon == std::string::npos) {
+                    throw std::invalid_argument("--target needs HOST:PORT");
+                }
+                config.host = value.substr(0, colon);
+                config.port = std::stoi(value.substr(colon + 1));
+                config.external = true;
+            } else if (option == "--server-threads") {
+                config.server_threads = parse_list(value);
+            } else if (option == "--io-backend") {
+                if (value == "epoll") {
+                    config.io_backend = IoBackend::EPOLL;
+                } else if (value == "io_uring") {
+                    config.io_backend = IoBackend::IO_URING;
+                } else {
+                    throw std::invalid_argument("--io-backend needs epoll or io_uring");
+                }
+            } else if (option == "--port") {
+                config.port = std::stoi(value);
+            } else if (option == "--connections") {
+                config.connections = std::max<size_t>(std::stoul(value), 1);
+            } else if (option == "--pipeline") {
+                config.pipeline = std::max<size_t>(std::stoul(value), 1);
+            } else if (option == "--rate") {
+                config.rate = std::stod(value);
+            } else if (option == "--duration") {
+                config.duration_seconds = std::stod(value);
+            } else if (option == "--warmup") {
+                config.warmup_seconds = std::stod(value);
+            } else if (option == "--client-threads") {
+                config.client_threads = std::max<size_t>(std::stoul(value), 1);
+            } else if (option == "--request") {
+                config.templates.push_back(parse_template(value));
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    if (config.templates.empty()) {
+        config.templates.push_back(parse_template("GET /hello"));
+    }
+    if (config.server_threads.empty()) {
+        config.server_threads.push_back(cores);
+    }
+
+    if (config.external) {
+        print_result(config, std::format("{}:{}", config.host, config.port), run_load(config));
+        return 0;
+    }
+
+    // The server's log lines go to std::cout; keep them out of the report, and keep
+    // per-request INFO logging from dominating what is measured.
+    std::ofstream null_output("/dev/null");
+    std::streambuf* stdout_buffer = std::cout.rdbuf(null_output.rdbuf());
+    std::vector<std::pair<size_t, LoadResult>> runs;
+    for (size_t threads : config.server_threads) {
+        auto server = std::make_unique<HttpServer>(config.port, threads);
+        add_load_routes(server->router);
+        server->set_io_backend(config.io_backend);
+        HttpServer::running = true;
+        std::thread serving([&server]() { server->start(); });
+        bool listening = wait_until_listening(config);
+        Logger::get_instance().set_level(LogLevel::WARNING);
+        if (listening) {
+            runs.emplace_back(threads, run_load(config));
+            // Loops whose ring could not be set up run on epoll instead.
+            size_t uring_loops = server->get_io_uring_loops();
+            std::string backend = uring_loops == 0 ? "epoll"
+                : uring_loops == threads ? "io_uring"
+                : std::format("io_uring on {} of {} loops, epoll on the rest", uring_loops, threads);
+            print_result(config, std::format("{} server threads, {}", threads, backend), runs.back().second);
+        } else {
+            std::fprintf(stderr, "in-process server did not start on port %d\n", config.port);
+        }
+        server->stop();
+        serving.join();
+        if (!listening) {
+            break;
+        }
+    }
+    std::cout.rdbuf(stdout_buffer);
+
+    if (runs.size() > 1) {
+        std::printf("\n%-8s %12s %10s %10s %10s %10s\n", "threads", "req/s", "p50", "p99", "p99.9", "max");
+        for (const auto& [threads, result] : runs) {
+            std::printf("%-8zu %12.0f %10s %10s %10s %10s\n", threads, result.completed / config.duration_seconds,
+                        format_duration(result.latency.percentile(0.5)).c_str(),
+                        format_duration(result.latency.percentile(0.99)).c_str(),
+                        format_duration(result.latency.percentile(0.999)).c_str(),
+                        format_duration(result.latency.max()).c_str());
+        }
+    }
+    return 0;
+}
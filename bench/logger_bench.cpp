@@ -0,0 +1,43 @@
+#include "bench.hpp"
+#include "../include/logger.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+void run_logger_benchmarks(BenchSuite& suite) {
+    Logger& logger = Logger::get_instance();
+    const std::string message = "Handled request for client 42";
+
+    logger.set_level(LogLevel::WARNING);
+    suite.run("logger/filtered", [&]() {
+        logger.info("Handled request for client {}", 42);
+    });
+
+    // Synchronous output goes to std::cout, pointed at /dev/null so the write and
+    // flush still happen without cluttering the report.
+    logger.set_level(LogLevel::INFO);
+    std::ofstream null_output("/dev/null");
+    std::streambuf* stdout_buffer = std::cout.rdbuf(null_output.rdbuf());
+    suite.run("logger/sync", [&]() {
+        logger.log(LogLevel::INFO, message);
+    });
+    suite.run("logger/sync_format", [&]() {
+        logger.info("Handled request for client {}", 42);
+    });
+    std::cout.rdbuf(stdout_buffer);
+
+    // The ring is sized, and the writer woken often enough, that it never fills, so
+    // this is the cost on the logging thread rather than the writer's pace.
+    AsyncLogConfig config{.path = "/dev/null", .ring_capacity = 1 << 16, .overflow = LogOverflowPolicy::BLOCK,
+                          .flush_interval = std::chrono::milliseconds(1)};
+    if (logger.enable_async(config)) {
+        suite.run("logger/async", [&]() {
+            logger.log(LogLevel::INFO, message);
+        });
+        suite.run("logger/async_format", [&]() {
+            logger.info("Handled request for client {}", 42);
+        });
+        logger.disable_async();
+    }
+}
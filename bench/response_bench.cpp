@@ -0,0 +1,46 @@
+#include "bench.hpp"
+#include "../include/http_response.hpp"
+#include <string>
+
+void run_response_benchmarks(BenchSuite& suite) {
+    suite.run("response/to_string/text", [&]() {
+        HttpResponse response;
+        response.set_content_type(MimeType::TextPlain);
+        response.set_body("Hello, World!");
+        std::string wire = response.to_string();
+        do_not_optimize(wire);
+    });
+    suite.run("response/to_string/json_headers", [&]() {
+        HttpResponse response;
+        response.set_status(HttpStatusCode::Created);
+        response.set_content_type(MimeType::ApplicationJson);
+        response.set_header("Cache-Control", "no-store");
+        response.set_header("Location", "/api/v1/orders/8812");
+        response.set_header("X-Request-Id", "6f1c2a9e-44b0-4c1d-9a57-0c3e2b7d91f4");
+        response.set_body("{\"id\":8812,\"item\":\"widget\",\"quantity\":3,\"status\":\"created\"}");
+        std::string wire = response.to_string();
+        do_not_optimize(wire);
+    });
+
+    // A prepared response serialized again, as a cached or reused response would be.
+    HttpResponse prepared;
+    prepared.set_content_type(MimeType::TextHtml);
+    prepared.set_body(std::string(4096, 'x'));
+    suite.run("response/to_string/4k_prepared", [&]() {
+        std::string wire = prepared.to_string();
+        do_not_optimize(wire);
+    });
+
+    // The serving path: a head appended to a connection's reused write buffer,
+    // with the loop's rendered Server, Date and Connection lines.
+    CommonHeaders common;
+    std::string write_buffer;
+    suite.run("response/serialize_head/common", [&]() {
+        HttpResponse response;
+        response.set_content_type(MimeType::TextPlain);
+        response.set_body("Hello, World!");
+        write_buffer.clear();
+        response.serialize_head(write_buffer, common, true);
+        do_not_optimize(write_buffer);
+    });
+}
@@ -0,0 +1,57 @@
+#include "bench.hpp"
+#include "../include/router.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace {
+
+HttpResponse empty_handler(const HttpRequest&) {
+    return HttpResponse();
+}
+
+// A REST-style API of `count` routes: per resource a collection, an item with a
+// parameter and a nested item, so lookups walk shared prefixes as in real trees.
+void add_api_routes(Router& router, size_t count) {
+    for (size_t i = 0; router.get_routes().size() < count; ++i) {
+        std::string base = std::format("/api/v1/resource{}", i);
+        router.add_route<&empty_handler>(RequestMethod::GET, base);
+        if (router.get_routes().size() < count) {
+            router.add_route<&empty_handler>(RequestMethod::GET, base + "/{id}");
+        }
+        if (router.get_routes().size() < count) {
+            router.add_route<&empty_handler>(RequestMethod::GET, base + "/{id}/items/{item}");
+        }
+    }
+}
+
+}
+
+void run_router_benchmarks(BenchSuite& suite) {
+    for (size_t count : {10, 100, 1000}) {
+        Router router;
+        add_api_routes(router, count);
+        // The last resource with all three routes.
+        size_t last = count / 3 - 1;
+        std::string static_path = std::format("/api/v1/resource{}", last);
+        std::string param_path = std::format("/api/v1/resource{}/12345", last);
+        std::string nested_path = std::format("/api/v1/resource{}/12345/items/678", last);
+        HttpRequest request;
+        auto bench = [&](const char* kind, const std::string& path) {
+            if (std::string_view(kind) != "miss" && router.match_route(RequestMethod::GET, path, request) == nullptr) {
+                std::fprintf(stderr, "router benchmark: %s does not match\n", path.c_str());
+                std::exit(1);
+            }
+            suite.run(std::format("router/{}/{}", kind, count), [&]() {
+                const RouteHandler* handler = router.match_route(RequestMethod::GET, path, request);
+                do_not_optimize(handler);
+            });
+        };
+        bench("static", static_path);
+        bench("param", param_path);
+        bench("nested", nested_path);
+        bench("miss", "/api/v2/unknown/path");
+    }
+}
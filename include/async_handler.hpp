@@ -0,0 +1,158 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include "http_response.hpp"
+#include "route_handler.hpp"
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+
+class Connection;
+
+// Return type of a coroutine handler, which co_returns its HttpResponse:
+//
+//   router.add_async_route(RequestMethod::POST, "/echo", [](RequestContext& ctx) -> AsyncResponse {
+//       std::string_view body = co_await ctx.read_body();
+//       co_await ctx.sleep(std::chrono::milliseconds(50));
+//       HttpResponse response;
+//       response.set_body(std::string(body));
+//       co_return response;
+//   });
+//
+// The frame is created suspended and resumed by the connection's event loop.
+class AsyncResponse {
+public:
+    struct promise_type {
+        HttpResponse response;
+        std::exception_ptr error;
+
+        AsyncResponse get_return_object() {
+            return AsyncResponse(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(HttpResponse value) { response = std::move(value); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    AsyncResponse() = default;
+    AsyncResponse(AsyncResponse&& other) noexcept : frame_(std::exchange(other.frame_, nullptr)) {}
+    AsyncResponse& operator=(AsyncResponse&& other) noexcept {
+        if (this != &other) {
+            reset();
+            frame_ = std::exchange(other.frame_, nullptr);
+        }
+        return *this;
+    }
+    AsyncResponse(const AsyncResponse&) = delete;
+    AsyncResponse& operator=(const AsyncResponse&) = delete;
+    ~AsyncResponse() { reset(); }
+
+    std::coroutine_handle<> handle() const { return frame_; }
+    bool done() const { return !frame_ || frame_.done(); }
+    // The co_returned response of a finished handler; rethrows what it threw.
+    HttpResponse take_response() {
+        if (frame_.promise().error) {
+            std::rethrow_exception(frame_.promise().error);
+        }
+        return std::move(frame_.promise().response);
+    }
+
+private:
+    explicit AsyncResponse(std::coroutine_handle<promise_type> frame) : frame_(frame) {}
+    void reset() {
+        if (frame_) {
+            frame_.destroy();
+            frame_ = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> frame_;
+};
+
+// A coroutine handler's view of its request and connection. Its awaitables are
+// completed by the owning EventLoop, so the handler always resumes on the loop
+// thread and must not block it. They are awaited directly in the handler, one at
+// a time.
+class RequestContext {
+public:
+    struct BodyAwaiter {
+        RequestContext& context;
+        bool await_ready() const noexcept { return context.body_ready_; }
+        void await_suspend(std::coroutine_handle<> waiting) noexcept { context.suspend(Wait::BODY, waiting); }
+        std::string_view await_resume() const noexcept { return context.request_.body; }
+    };
+
+    struct SleepAwaiter {
+        RequestContext& context;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> waiting) noexcept { context.suspend(Wait::SLEEP, waiting); }
+        void await_resume() const noexcept {}
+    };
+
+    struct WriteAwaiter {
+        RequestContext& context;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> waiting) noexcept { context.suspend(Wait::DRAIN, waiting); }
+        void await_resume() const noexcept {}
+    };
+
+    // Valid for the whole call. The body is empty until read_body() completes.
+    const HttpRequest& request() const { return request_; }
+    // Status and headers of a streamed response, sent with the first write().
+    HttpResponse& response() { return response_; }
+    // Resumes with the complete request body once it has arrived.
+    BodyAwaiter read_body() { return BodyAwaiter{*this}; }
+    // Resumes after `duration`, measured on the loop's timer wheel.
+    SleepAwaiter sleep(std::chrono::milliseconds duration) {
+        sleep_for_ = duration;
+        return SleepAwaiter{*this};
+    }
+    // Sends `chunk` as part of a chunked response and resumes once the socket has
+    // taken it. The co_returned response's body becomes the last chunk and its
+    // status and headers are ignored. HTTP/1.0 clients get the whole body at once.
+    WriteAwaiter write(std::string chunk) {
+        chunk_ = std::move(chunk);
+        return WriteAwaiter{*this};
+    }
+
+private:
+    friend class Connection;
+
+    enum class Wait {
+        NONE, BODY, SLEEP, DRAIN
+    };
+
+    void suspend(Wait wait, std::coroutine_handle<> waiting) {
+        wait_ = wait;
+        waiting_ = waiting;
+    }
+
+    HttpRequest request_;
+    HttpResponse response_;
+    bool body_ready_ = false;
+    Wait wait_ = Wait::NONE;
+    std::coroutine_handle<> waiting_;
+    std::chrono::milliseconds sleep_for_{0};
+    std::string chunk_;
+};
+
+using AsyncRouteHandler = BasicRouteHandler<AsyncResponse(RequestContext&)>;
+
+// A coroutine handler in progress on a connection, with its own copy of the request
+// so it can outlive the read buffer. `task` is declared last so the frame, which
+// refers to the context, is destroyed first.
+struct AsyncCall {
+    // The request as received when the handler started, and its body if that
+    // arrived later.
+    std::string data;
+    std::string body;
+    RequestContext context;
+    // Chunked framing for HTTP/1.1; HTTP/1.0 responses are buffered instead.
+    bool chunked = false;
+    bool streaming = false;
+    AsyncResponse task;
+};
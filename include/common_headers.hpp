@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// The Server, Date and Connection lines written after every status line, kept
+// rendered so a response copies them instead of formatting a date. Each event
+// loop owns one and refreshes it whenever it wakes; only that loop reads it.
+class CommonHeaders {
+public:
+    static constexpr std::string_view SERVER_NAME = "bcpp";
+
+    CommonHeaders();
+
+    // Rewrites the date when `now` is a different second than the last call.
+    void refresh(std::time_t now);
+    // Appends the lines for a keep-alive or closing connection, leaving out Server
+    // or Date when the response carries its own.
+    void append_to(std::string& out, bool keep_alive, bool with_server = true, bool with_date = true) const;
+
+private:
+    static constexpr size_t SERVER_LINE_SIZE = std::string_view("Server: \r\n").size() + SERVER_NAME.size();
+    static constexpr size_t DATE_OFFSET = SERVER_LINE_SIZE + std::string_view("Date: ").size();
+    // An IMF-fixdate is always this long.
+    static constexpr size_t DATE_SIZE = 29;
+    static constexpr size_t DATE_LINE_SIZE = std::string_view("Date: \r\n").size() + DATE_SIZE;
+
+    std::time_t time_;
+    std::string keep_alive_lines_;
+    std::string close_lines_;
+};
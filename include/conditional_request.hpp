@@ -0,0 +1,19 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include "http_response.hpp"
+
+// Applies the request's validators and Range header to a 200 response to a GET or
+// HEAD, using the ETag and Last-Modified headers the handler set:
+//  - If-None-Match, or else If-Modified-Since, turns a fresh response into a
+//    bodyless 304.
+//  - Range, unless an If-Range validator is stale, cuts the body down to one
+//    range (206 with Content-Range), several ranges (206 multipart/byteranges), or
+//    nothing (416 with "Content-Range: bytes */<length>").
+// Slices reference the original segments, so file bodies are still sent with
+// sendfile. Other responses are left untouched.
+void apply_conditional_request(const HttpRequest& request, HttpResponse& response);
+// True if the request's If-None-Match, or else If-Modified-Since, shows the client
+// already holds the version described by `etag` and `last_modified` (empty when
+// the response has no such validator).
+bool is_not_modified(const HttpRequest& request, std::string_view etag, std::string_view last_modified);
@@ -1,37 +1,218 @@
 #pragma once
 
+#include "async_handler.hpp"
+#include "common_headers.hpp"
 #include "http_request_parser.hpp"
+#include "http_response.hpp"
+#include "metrics.hpp"
+#include "request_arena.hpp"
 #include "router.hpp"
+#include "timer_wheel.hpp"
+#include "worker_pool.hpp"
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
 
 enum class ConnectionStatus {
     READING,
     WRITING, 
+    // A blocking handler is running on the worker pool, or a coroutine handler is
+    // suspended; no I/O until it completes or resumes.
+    AWAITING,
     CLOSING
 };
 
+// Which deadline currently applies to a connection.
+enum class ConnectionPhase {
+    IDLE,       // keep-alive: waiting for the first byte of a request
+    HEADER,     // request head partially received
+    BODY,       // head complete, body still arriving
+    HANDLER,    // waiting for a blocking or suspended coroutine handler
+    WRITE       // response queued, waiting for the socket
+};
+
+// Connections are pooled by ConnectionSlab: open() attaches a freshly accepted
+// socket and release() closes it, keeping the buffers for the next client.
 class Connection {
 public:
-    Connection(int client_fd, Router& router);
+    Connection(Router& router, LoopMetrics& metrics, const CommonHeaders& common_headers);
     ~Connection();
 
+    // Bookkeeping for the io_uring backend, kept by the event loop.
+    struct RingState {
+        bool recv_armed = false;
+        // A receive cancelled to stop reading ahead; it stays armed until its last
+        // completion arrives.
+        bool recv_cancelled = false;
+        bool eof = false;
+        // A sendmsg, or a POLLOUT poll before a sendfile, is in flight; the output
+        // it refers to must stay put.
+        bool send_in_flight = false;
+        // Closed while a send was in flight; released once it completes.
+        bool closing = false;
+    };
+
+    void open(int fd, uint64_t slab_handle);
+    void release();
+    bool is_open() const;
+
     void handle_read();
     void handle_write();
-
-    bool is_timed_out(int time_seconds) const;
-    void update_last_activity();
+    // io_uring backend: bytes from a receive completion. Returns false once the
+    // connection has buffered enough input it is not consuming yet.
+    bool handle_received(const char* data, size_t size);
+    void handle_peer_closed();
+    // io_uring backend: gathers the unsent output into one message, or returns
+    // nullptr when the next segment is a file, which handle_write sends instead.
+    const struct msghdr* prepare_send();
+    void complete_send(int result);
+    RingState& get_ring_state();
+    // Keeps the loop's idle connection gauge in step; called by the loop each time
+    // it settles the connection.
+    void track_phase(ConnectionPhase phase);
 
     int get_client_fd() const;
+    uint64_t get_handle() const;
     ConnectionStatus get_state() const;
+    ConnectionPhase get_phase() const;
+    TimerNode& get_timer();
+    // Fires when a coroutine handler's sleep() has elapsed.
+    TimerNode& get_sleep_timer();
+    // The delay a coroutine handler asked for in its last sleep(), reported once
+    // so the event loop can arm the sleep timer.
+    std::optional<std::chrono::milliseconds> take_sleep();
+    // Resumes a coroutine handler whose sleep has elapsed.
+    void wake_sleeper();
+    // Hands over a request for a blocking route, queued by the last read or
+    // completion; nullptr if there is none.
+    std::unique_ptr<DeferredRequest> take_deferred();
+    // Queues the reply to the deferred request and resumes the pipeline behind it.
+    void complete_deferred(RouteReply& reply);
+    // True when the last read/write stopped on its fairness budget rather than EAGAIN,
+    // so the socket may still be ready and the loop must come back to it.
+    bool has_pending_io() const;
 private:
-    void process_request();
+    static constexpr size_t READ_CHUNK_SIZE = 16 * 1024;
+    static constexpr size_t READ_BUDGET = 256 * 1024;
+    static constexpr size_t WRITE_BUDGET = 256 * 1024;
+    // Buffers that grew past this for one large request are not kept in the pool.
+    static constexpr size_t RETAINED_BUFFER_SIZE = 64 * 1024;
+    // Bodies up to this size are copied next to their head; larger ones are queued
+    // as their own segment.
+    static constexpr size_t INLINE_BODY_SIZE = 4 * 1024;
+    static constexpr int MAX_IOVECS = 64;
+
+    // A queued response whose write time is recorded once the send cursor passes
+    // `end`, the output index after its last segment.
+    struct WriteTiming {
+        RouteMetrics* route;
+        uint64_t queued_ns;
+        size_t end;
+    };
+
+    // A queued piece of output: either a range of write_buffer (response heads and
+    // small bodies) or a body segment taken over from the response.
+    struct OutputSegment {
+        size_t offset;
+        size_t length;
+        BodySegment body;
+    };
+
+    void process_pipeline();
+    // parser.parse, timed into parse_ns while metrics are enabled.
+    bool parse_next(std::string_view data);
+    // Metrics for a request about to be handled: where it is recorded, when its
+    // handler started and the output queued before it.
+    void begin_handling(const RouteTree::Route* route);
+    void record_received(size_t bytes);
+    void finish_handling(unsigned status);
+    void record_writes();
+    // `raw` is the request's bytes in read_buffer.
+    void process_request(std::string_view raw);
+    // Answers a head the parser rejected with 400 and closes; `received` is the
+    // unconsumed input, counted as the request's bytes.
+    void reject_malformed(size_t received);
+    void defer_request(const RouteTree::Route& route, std::string_view raw);
+    // Starts a coroutine handler on the request at the front of `raw`, which holds
+    // only its head while the body is still arriving.
+    void start_async(const RouteTree::Route& route, std::string_view raw, bool complete);
+    void route_head(std::string_view raw);
+    void deliver_body();
+    // Resumes the coroutine handler until it waits for something the loop has to
+    // complete, queueing what it writes.
+    void drive_async();
+    void finish_async();
+    // Resumes a handler waiting for its chunk to be sent once the output is drained.
+    bool resume_writer();
+    bool async_running() const;
+    void queue_stream_head();
+    void queue_chunk(BodySegment segment);
+    void queue_reply(RouteReply& reply);
+    void queue_response(HttpResponse& response);
+    void queue_cached(const CachedResponse& cached);
+    void queue_body(BodySegment segment, size_t& begin);
+    void queue_buffered(size_t begin);
+    // Sends queued output until it is drained, the socket is full or the budget
+    // is spent; `sent` accumulates across calls in one handle_write.
+    void write_output(size_t& sent);
+    // Fills `iov` with the memory segments from the send cursor up to the next file.
+    int gather_output(struct iovec* iov) const;
+    // Called with the output queue sent: resets it, then either lets more output be
+    // queued (true) or settles the state of an idle connection (false).
+    bool refill_output();
+    void seal_output();
+    void advance_output(size_t bytes);
+    std::string_view output_view(const OutputSegment& segment) const;
+    bool has_output() const;
     static bool should_keep_alive(const HttpRequest& request);
     int client_fd;
+    uint64_t handle;
     Router& router;
+    LoopMetrics& metrics;
+    const CommonHeaders& common_headers;
     ConnectionStatus state;
     bool keep_alive;
+    bool io_budget_exhausted;
+    // Set from deferral until complete_deferred; `deferred` is only held until the
+    // event loop takes it.
+    bool awaiting;
+    std::unique_ptr<DeferredRequest> deferred;
+    std::unique_ptr<AsyncCall> async;
+    // Whether the partially received request has been checked for a coroutine route.
+    bool head_routed;
+    bool sleep_requested;
+    bool peer_closed;
+    RingState ring_state;
     HttpRequestParser parser;
+    // Responses of synchronous handlers; released after each one is queued.
+    RequestArena arena;
     std::string read_buffer;
     std::string write_buffer;
-    std::chrono::steady_clock::time_point last_activity;
+    std::vector<OutputSegment> output;
+    // Send cursor: first unsent segment and the bytes of it already sent.
+    size_t output_index;
+    size_t output_offset;
+    // io_uring sends: the message in flight and the buffer its head bytes were
+    // moved to, reused once nothing refers to it.
+    struct iovec send_iov[MAX_IOVECS];
+    struct msghdr send_message;
+    std::shared_ptr<std::string> sealed_buffer;
+    TimerNode timer;
+    TimerNode sleep_timer;
+    // Metrics bookkeeping; `handling` is null while metrics are disabled.
+    bool counted_idle;
+    uint64_t parse_ns;
+    uint64_t parsed_at_ns;
+    RouteMetrics* handling;
+    uint64_t handling_started_ns;
+    uint64_t handling_bytes_start;
+    // Bytes ever appended to the output queue.
+    uint64_t queued_bytes;
+    std::vector<WriteTiming> write_timings;
+    size_t write_timing_index;
 };
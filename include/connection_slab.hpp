@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common_headers.hpp"
+#include "connection.hpp"
+#include "metrics.hpp"
+#include "router.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Per-loop pool of Connection objects. A connection is addressed by a handle that
+// packs its slot index with the slot's generation, which changes every time the
+// slot is recycled, so an event or timer for a connection that has since been
+// closed resolves to nullptr instead of to the slot's new occupant. Released
+// connections keep their buffers, so steady-state churn does not allocate.
+class ConnectionSlab {
+public:
+    ConnectionSlab(Router& router, LoopMetrics& metrics, const CommonHeaders& common_headers);
+
+    // Handles never produced by the slab, free for the loop's own fds.
+    static constexpr uint64_t RESERVED_HANDLE_BASE = 0xFFFFFFFF00000000ull;
+
+    Connection* acquire(int client_fd);
+    Connection* get(uint64_t handle) const;
+    void release(Connection* connection);
+    size_t size() const;
+
+private:
+    struct Slot {
+        std::unique_ptr<Connection> connection;
+        uint32_t generation = 0;
+    };
+
+    Router& router;
+    LoopMetrics& metrics;
+    const CommonHeaders& common_headers;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    size_t in_use;
+};
@@ -1,22 +1,123 @@
 #pragma once
 
+#include "common_headers.hpp"
 #include "connection.hpp"
+#include "connection_slab.hpp"
+#include "io_uring.hpp"
+#include "metrics.hpp"
 #include "router.hpp"
+#include "timer_wheel.hpp"
+#include "worker_pool.hpp"
+#include <chrono>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <vector>
+
+// Per-phase connection deadlines. The header deadline covers the whole request
+// head; the others restart whenever the connection makes progress.
+struct TimeoutConfig {
+    std::chrono::milliseconds keep_alive{std::chrono::seconds(10)};
+    std::chrono::milliseconds header{std::chrono::seconds(10)};
+    std::chrono::milliseconds body{std::chrono::seconds(30)};
+    // Time allowed for a response once the request is complete. Handlers that run
+    // inline on the loop cannot be interrupted, so this covers deferred responses
+    // and suspended coroutine handlers.
+    std::chrono::milliseconds handler{std::chrono::seconds(30)};
+    std::chrono::milliseconds write{std::chrono::seconds(30)};
+};
+
+// How an event loop waits for and performs socket I/O.
+enum class IoBackend {
+    // Readiness via edge-triggered epoll; connections call recv/sendmsg themselves.
+    EPOLL,
+    // Completions via io_uring: multishot accept and receive into provided buffers,
+    // with each round's sends submitted together. Falls back to EPOLL when the
+    // kernel does not support it.
+    IO_URING
+};
+
 class EventLoop {
 public:
-    EventLoop(Router& router, int keep_alive_timeout);
+    EventLoop(Router& router, const TimeoutConfig& timeouts);
     ~EventLoop();
 
+    void set_timeouts(const TimeoutConfig& config);
     void run();
+    // Interrupts epoll_wait; async-signal-safe.
+    void wake();
+    // Thread-safe: queues an accepted socket and wakes the loop to register it.
     void add_connection(int client_fd);
+    // Accepts from a non-blocking listening socket inside this loop. With `exclusive`
+    // the socket may be shared by several loops and epoll wakes only one of them.
+    void add_listener(int fd, bool take_ownership, bool exclusive);
+    // Requests for blocking routes go to `pool`; without one they run inline.
+    void set_worker_pool(WorkerPool* pool);
+    // Moves the loop onto io_uring; call before add_listener and run(). Returns
+    // false, leaving the loop on epoll, when the kernel does not support it.
+    bool use_io_uring();
+    // Written by the loop's thread only; readable from any thread.
+    LoopMetrics& get_metrics();
+    const LoopMetrics& get_metrics() const;
+    // Thread-safe: hands back a request run on the worker pool and wakes the loop
+    // through its completion eventfd to send the reply.
+    void complete_deferred(std::unique_ptr<DeferredRequest> job);
 
 private:
+    static constexpr int ACCEPT_BATCH = 64;
+    static constexpr uint64_t TIMER_TICK_MS = 10;
+    // epoll_event.data.u64 carries a slab handle for connections and these tags
+    // for the loop's own descriptors.
+    static constexpr uint64_t WAKE_HANDLE = ConnectionSlab::RESERVED_HANDLE_BASE;
+    static constexpr uint64_t LISTENER_HANDLE = ConnectionSlab::RESERVED_HANDLE_BASE + 1;
+    static constexpr uint64_t COMPLETION_HANDLE = ConnectionSlab::RESERVED_HANDLE_BASE + 2;
+    static constexpr unsigned RING_ENTRIES = 1024;
+    static constexpr unsigned RING_BUFFER_COUNT = 256;
+    static constexpr size_t RING_BUFFER_SIZE = 16 * 1024;
+
+    void register_handoffs();
+    void accept_connections();
+    void register_connection(int client_fd);
     void handle_events();
-    void check_timeout();
+    void handle_completions();
+    void complete_ring_op(const struct io_uring_cqe& cqe);
+    void complete_recv(Connection* conn, const struct io_uring_cqe& cqe);
+    // Submits the receive or send a connection needs next under io_uring.
+    void start_ring_io(Connection* conn);
+    void serve_connection(Connection* conn, uint32_t ready_events);
+    // Follows up on a connection whose state may have changed: closes it, submits
+    // a deferred request, re-arms its deadline and updates its epoll interest.
+    void settle_connection(Connection* conn, ConnectionStatus before, ConnectionPhase phase_before);
+    void submit_deferred(Connection* conn);
+    void finish_deferred();
+    void expire_timers();
+    std::chrono::milliseconds deadline_for(ConnectionPhase phase) const;
+    void close_connection(Connection* conn);
     int epoll_fd;
+    int wake_fd;
+    int completion_fd;
     Router& router;
-    int keep_alive_timeout;
-    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    TimeoutConfig timeouts;
+    int listen_fd;
+    bool owns_listener;
+    uint64_t loop_time_ms;
+    TimerWheel timers;
+    // Before the connections, which refer to them.
+    LoopMetrics metrics;
+    CommonHeaders common_headers;
+    std::mutex handoff_mtx;
+    std::vector<int> handoff_fds;
+    std::vector<int> registering_fds;
+    ConnectionSlab connections;
+    WorkerPool* worker_pool;
+    std::mutex completed_mtx;
+    std::vector<std::unique_ptr<DeferredRequest>> completed;
+    std::vector<std::unique_ptr<DeferredRequest>> finishing;
+    // Handles of connections to serve again without waiting for an edge; swapped
+    // with carried_over each round so neither vector reallocates in steady state.
+    std::vector<uint64_t> pending;
+    std::vector<uint64_t> carried_over;
+    // Set by use_io_uring. Declared after the connections so it is torn down, and
+    // its requests cancelled, before the buffers they point into.
+    std::unique_ptr<IoUring> ring;
 };
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+// A read-only file opened for serving, with the metadata sent alongside it. The
+// descriptor stays open while any response still refers to it, even after the
+// cache has dropped or replaced the entry.
+struct OpenFile {
+    OpenFile(int fd, const struct stat& info);
+    ~OpenFile();
+    OpenFile(const OpenFile&) = delete;
+    OpenFile& operator=(const OpenFile&) = delete;
+
+    // True if `info` describes the same version of the file.
+    bool matches(const struct stat& info) const;
+
+    int fd;
+    uint64_t size;
+    time_t modified;
+    std::string etag;
+    std::string last_modified;
+private:
+    dev_t device;
+    ino_t inode;
+    int64_t modified_ns;
+};
+
+// Caches open descriptors and stat results by path. An entry is trusted for `ttl`
+// and then revalidated with stat(); a file that changed on disk is reopened.
+// Thread-safe, shared by all event loops.
+class FileCache {
+public:
+    FileCache(std::chrono::milliseconds ttl, size_t max_entries);
+
+    // Returns nullptr if the path does not name a readable regular file.
+    std::shared_ptr<const OpenFile> open(const std::string& path);
+    void clear();
+
+private:
+    struct Entry {
+        std::shared_ptr<const OpenFile> file;
+        std::chrono::steady_clock::time_point checked;
+    };
+
+    void evict_oldest();
+
+    std::chrono::milliseconds ttl;
+    size_t max_entries;
+    std::mutex mtx;
+    std::unordered_map<std::string, Entry> entries;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// A line of a request head as offsets into the data scanned. `end` excludes the
+// CRLF; `colon` is the line's first ':' or HeadScanner::NO_COLON.
+struct HeadLine {
+    size_t start;
+    size_t end;
+    size_t colon;
+};
+
+enum class ScanKernel {
+    SCALAR, SSE2, AVX2
+};
+
+// Finds the line ends, colons and control characters of a request head in one
+// pass. A vector kernel turns each 64 bytes into bitmasks of line feeds, colons
+// and invalid bytes; lines are then walked by their line-feed bits, so header text
+// is never looked at byte by byte. Data may arrive over several calls; scanning
+// resumes where it stopped.
+class HeadScanner {
+public:
+    static constexpr size_t NO_COLON = SIZE_MAX;
+
+    HeadScanner();
+    // `data` starts at the request and may have grown since the previous call.
+    // Returns true once the head is complete or found invalid.
+    bool scan(std::string_view data);
+    void reset();
+
+    // Lines before the blank one ending the head, the request line first.
+    const std::vector<HeadLine>& lines() const;
+    // Bytes up to and including the blank line; valid once scan returned true.
+    size_t head_size() const;
+    // A control character other than tab, or a CR not followed by LF.
+    bool invalid() const;
+
+    // The fastest kernel the CPU supports is chosen on first use. Selecting
+    // another one is for benchmarks; it returns false if the CPU lacks it.
+    static ScanKernel active_kernel();
+    static bool select_kernel(ScanKernel kernel);
+    static bool kernel_supported(ScanKernel kernel);
+    static const char* kernel_name(ScanKernel kernel);
+
+private:
+    enum class Step {
+        CONTINUE, DONE, NEED_MORE
+    };
+
+    // Handles one block's line feeds and invalid bytes (`events`) in order.
+    Step scan_block(std::string_view data, size_t base, uint64_t events, uint64_t colons);
+
+    std::vector<HeadLine> lines_;
+    size_t pos_;
+    size_t line_start_;
+    size_t colon_;
+    size_t head_size_;
+    bool done_;
+    bool invalid_;
+};
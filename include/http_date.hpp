@@ -0,0 +1,12 @@
+#pragma once
+
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Formats a time as an HTTP date (IMF-fixdate), e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+std::string format_http_date(time_t time);
+// Parses an IMF-fixdate. The obsolete RFC 850 and asctime forms are not accepted;
+// callers treat an unparsable date as if the header were absent.
+std::optional<time_t> parse_http_date(std::string_view text);
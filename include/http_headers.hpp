@@ -0,0 +1,226 @@
+#pragma once
+
+#include "inline_vector.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Headers the server reads or writes itself. Their fields are found through a
+// slot per header instead of by comparing names.
+enum class KnownHeader : uint8_t {
+    Accept,
+    AcceptEncoding,
+    AcceptRanges,
+    Authorization,
+    CacheControl,
+    Connection,
+    ContentEncoding,
+    ContentLength,
+    ContentRange,
+    ContentType,
+    Cookie,
+    Date,
+    ETag,
+    Expect,
+    Host,
+    IfModifiedSince,
+    IfNoneMatch,
+    IfRange,
+    LastModified,
+    Location,
+    Range,
+    Server,
+    SetCookie,
+    TransferEncoding,
+    UserAgent,
+    Vary
+};
+
+constexpr size_t KNOWN_HEADER_COUNT = static_cast<size_t>(KnownHeader::Vary) + 1;
+
+// Header names compare without regard to ASCII case (RFC 9110 5.1).
+std::optional<KnownHeader> find_known_header(std::string_view name);
+// The spelling used when serializing, e.g. "Content-Length".
+std::string_view known_header_name(KnownHeader header);
+bool iequals(std::string_view a, std::string_view b);
+
+// Header fields in the order they were added. Well-known names are interned to
+// a KnownHeader slot; other names are kept and compared case-insensitively.
+// `String` is std::string_view for request headers, which point into the read
+// buffer, and std::pmr::string for responses, allocated from the request arena.
+template <typename String>
+class HeaderMap {
+public:
+    struct Field {
+        std::optional<KnownHeader> known;
+        // Only set for names that are not well-known.
+        String name;
+        String value;
+
+        std::string_view get_name() const {
+            return known ? known_header_name(*known) : std::string_view(name);
+        }
+    };
+
+    HeaderMap() {
+        slots_.fill(NO_FIELD);
+    }
+
+    // Appends a field. Lookups of a repeated name return its first value.
+    void add(std::string_view name, String value) {
+        std::optional<KnownHeader> known = find_known_header(name);
+        if (known) {
+            uint32_t& slot = slots_[static_cast<size_t>(*known)];
+            if (slot == NO_FIELD) {
+                slot = static_cast<uint32_t>(fields_.size());
+            }
+            fields_.emplace_back(known, String(), std::move(value));
+        } else {
+            String owned_name = make_name(name, value);
+            fields_.emplace_back(std::nullopt, std::move(owned_name), std::move(value));
+        }
+    }
+
+    // Replaces the value of the first field named `name` and drops any others.
+    void set(std::string_view name, String value) {
+        if (std::optional<KnownHeader> known = find_known_header(name)) {
+            set(*known, std::move(value));
+            return;
+        }
+        for (size_t i = 0; i < fields_.size(); ++i) {
+            if (!fields_[i].known && iequals(fields_[i].name, name)) {
+                fields_[i].value = std::move(value);
+                remove_after(i);
+                return;
+            }
+        }
+        String owned_name = make_name(name, value);
+        fields_.emplace_back(std::nullopt, std::move(owned_name), std::move(value));
+    }
+
+    void set(KnownHeader header, String value) {
+        uint32_t slot = slots_[static_cast<size_t>(header)];
+        if (slot == NO_FIELD) {
+            slots_[static_cast<size_t>(header)] = static_cast<uint32_t>(fields_.size());
+            fields_.emplace_back(header, String(), std::move(value));
+            return;
+        }
+        fields_[slot].value = std::move(value);
+        remove_after(slot);
+    }
+
+    const String* find(KnownHeader header) const {
+        uint32_t slot = slots_[static_cast<size_t>(header)];
+        return slot == NO_FIELD ? nullptr : &fields_[slot].value;
+    }
+
+    const String* find(std::string_view name) const {
+        if (std::optional<KnownHeader> known = find_known_header(name)) {
+            return find(*known);
+        }
+        for (const Field& field : fields_) {
+            if (!field.known && iequals(field.name, name)) {
+                return &field.value;
+            }
+        }
+        return nullptr;
+    }
+
+    bool contains(KnownHeader header) const {
+        return slots_[static_cast<size_t>(header)] != NO_FIELD;
+    }
+
+    // Removes every field named `name`.
+    void remove(std::string_view name) {
+        std::optional<KnownHeader> known = find_known_header(name);
+        remove_if([&](const Field& field) {
+            return known ? field.known == known : !field.known && iequals(field.name, name);
+        });
+    }
+
+    void remove(KnownHeader header) {
+        if (contains(header)) {
+            remove_if([header](const Field& field) { return field.known == header; });
+        }
+    }
+
+    void clear() {
+        fields_.clear();
+        slots_.fill(NO_FIELD);
+    }
+
+    size_t size() const { return fields_.size(); }
+    bool empty() const { return fields_.size() == 0; }
+
+    Field* begin() { return fields_.begin(); }
+    Field* end() { return fields_.end(); }
+    const Field* begin() const { return fields_.begin(); }
+    const Field* end() const { return fields_.end(); }
+
+private:
+    static constexpr uint32_t NO_FIELD = UINT32_MAX;
+    // Most requests and responses carry fewer fields than this.
+    static constexpr size_t INLINE_FIELDS = 12;
+
+    // An owned name is allocated like its value, from the response's arena.
+    static String make_name(std::string_view name, const String& value) {
+        if constexpr (std::is_same_v<String, std::string_view>) {
+            return name;
+        } else {
+            return String(name, value.get_allocator());
+        }
+    }
+
+    // Drops repeats of the field at `index` added after it.
+    void remove_after(size_t index) {
+        const Field& kept = fields_[index];
+        std::optional<KnownHeader> known = kept.known;
+        std::string_view name = kept.name;
+        bool removed = false;
+        for (size_t i = fields_.size(); i-- > index + 1;) {
+            const Field& field = fields_[i];
+            if (known ? field.known == known : !field.known && iequals(field.name, name)) {
+                fields_.erase(i);
+                removed = true;
+            }
+        }
+        if (removed) {
+            reindex();
+        }
+    }
+
+    template <typename Predicate>
+    void remove_if(Predicate matches) {
+        bool removed = false;
+        for (size_t i = fields_.size(); i-- > 0;) {
+            if (matches(fields_[i])) {
+                fields_.erase(i);
+                removed = true;
+            }
+        }
+        if (removed) {
+            reindex();
+        }
+    }
+
+    void reindex() {
+        slots_.fill(NO_FIELD);
+        for (size_t i = 0; i < fields_.size(); ++i) {
+            if (fields_[i].known && slots_[static_cast<size_t>(*fields_[i].known)] == NO_FIELD) {
+                slots_[static_cast<size_t>(*fields_[i].known)] = static_cast<uint32_t>(i);
+            }
+        }
+    }
+
+    InlineVector<Field, INLINE_FIELDS> fields_;
+    std::array<uint32_t, KNOWN_HEADER_COUNT> slots_;
+};
+
+using RequestHeaders = HeaderMap<std::string_view>;
+using ResponseHeaders = HeaderMap<std::pmr::string>;
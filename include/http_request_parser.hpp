@@ -1,47 +1,73 @@
 #pragma once
 
-#include <map>
+#include "head_scanner.hpp"
+#include "http_headers.hpp"
+#include "request_params.hpp"
 #include <optional>
 #include <string>
+#include <string_view>
 
 enum class RequestMethod {
     GET, HEAD, OPTIONS, POST, DELETE, PUT
 };
 
+// A parsed request. Method, route, version, headers and body are views into the
+// connection's read buffer and are only valid until that buffer is consumed.
 struct HttpRequest {
     RequestMethod method;
-    std::string full_route;
-    std::string route;
-    std::string version;
-    std::map<std::string, std::string> headers;
-    std::map<std::string, std::string> query_params;
-    std::map<std::string, std::string> path_params;
-    std::optional<std::string> get_query_param(const std::string& key) const;
-    std::optional<std::string> get_path_param(const std::string& key) const;
-    std::string body;
+    std::string_view full_route;
+    std::string_view route;
+    std::string_view version;
+    RequestHeaders headers;
+    QueryParams query_params;
+    PathParams path_params;
+    // Values are views into the request, valid as long as its other views.
+    std::optional<std::string_view> get_query_param(std::string_view key) const;
+    std::optional<std::string_view> get_path_param(std::string_view key) const;
+    // Header names match case-insensitively; a repeated header yields its first value.
+    std::optional<std::string_view> get_header(std::string_view key) const;
+    std::optional<std::string_view> get_header(KnownHeader key) const;
+    std::string_view body;
 };
 
 class HttpRequestParser {
 public:
     HttpRequestParser();
-    bool parse(const std::string& data);
-    
-    HttpRequest get_request() const;
-    
+    // `data` is the connection buffer starting at the current request. It may grow
+    // between calls; scanning resumes where the previous call stopped.
+    bool parse(std::string_view data);
+
+    const HttpRequest& get_request() const;
+    HttpRequest& get_request();
+    // Bytes of `data` taken by the completed request (head and body).
+    size_t consumed() const;
+    // True once the head is parsed and the body is still incomplete.
+    bool in_body() const;
+    // True if the head is malformed: a control character, a bare CR, a header line
+    // without a valid field name, or a Content-Length that is not a decimal number.
+    // Nothing after it can be framed.
+    bool failed() const;
+
     void reset();
 
+    // Decodes %XX escapes and '+' as in query strings; malformed escapes are kept
+    // as they are.
+    static std::string url_decode(std::string_view encoded);
+
 private:
     enum class ParseState {
-        REQUEST_LINE, HEADERS, BODY, COMPLETE
+        REQUEST_LINE, HEADERS, BODY, COMPLETE, FAILED
     };
 
-    void parse_headers(const std::string& header_data);
-    void parse_request_line(const std::string& line);
-    void parse_query_params(const std::string& query_string);
-    std::string url_decode(const std::string& encoded);
-    size_t get_content_length();
+    bool parse_headers(std::string_view head);
+    void parse_request_line(std::string_view line);
+    // Sets content_length_; false if Content-Length is not a plain decimal number.
+    bool parse_content_length();
 
     ParseState state_;
     HttpRequest request_;
-    std::string buffer_;
+    HeadScanner scanner_;
+    const char* head_base_;
+    size_t head_size_;
+    size_t content_length_;
 };
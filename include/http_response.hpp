@@ -1,31 +1,98 @@
 #pragma once
 
+#include "common_headers.hpp"
+#include "http_headers.hpp"
 #include "http_status_code.hpp"
 #include "mime_type.hpp"
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <optional>
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <vector>
 
+struct OpenFile;
+
+// One piece of a response body. Owned strings are moved in; shared buffers are
+// only referenced, so one immutable payload can back many responses. File
+// segments are never read into memory and go to the socket with sendfile.
+class BodySegment {
+public:
+    BodySegment() = default;
+    BodySegment(std::string data);
+    BodySegment(std::shared_ptr<const std::string> data);
+    BodySegment(std::shared_ptr<const OpenFile> file, uint64_t offset, size_t length);
+
+    // Memory segments only; empty for a file segment.
+    std::string_view view() const;
+    size_t size() const;
+    bool is_file() const;
+    const OpenFile* file() const;
+    uint64_t file_offset() const;
+    // Appends the segment's bytes to `out`, reading them from disk for a file.
+    void append_to(std::string& out) const;
+    // The bytes [offset, offset + length) of this segment. Shared buffers and files
+    // are referenced again; an owned string is copied.
+    BodySegment slice(uint64_t offset, size_t length) const;
+private:
+    std::string owned_;
+    std::shared_ptr<const std::string> shared_;
+    std::shared_ptr<const OpenFile> file_;
+    uint64_t offset_ = 0;
+    size_t length_ = 0;
+};
+
+using BodySegments = std::pmr::vector<BodySegment>;
+
+// Headers and the body segment list are allocated from a memory resource: the
+// connection's RequestArena for a response built by a synchronous handler, the
+// default resource otherwise. A copy always uses the default resource, so a
+// response kept beyond its request has to be copied, not moved.
 class HttpResponse {
 public:
-    HttpResponse() = default;
-    ~HttpResponse() = default;
+    HttpResponse();
+    explicit HttpResponse(std::pmr::memory_resource* resource);
 
     void set_status(HttpStatusCode code);
     void set_status(unsigned int code);
     void set_status(const HttpStatus& status);
+    const HttpStatus& get_status() const;
 
-    void set_header(const std::string& key, const std::string& value);
-    std::optional<std::string> get_header(const std::string& key) const;
+    // Header names match case-insensitively. Headers are sent in the order they
+    // were first set.
+    void set_header(std::string_view key, std::string_view value);
+    void set_header(KnownHeader key, std::string_view value);
+    std::optional<std::string> get_header(std::string_view key) const;
+    std::optional<std::string> get_header(KnownHeader key) const;
+    void remove_header(std::string_view key);
+    void remove_header(KnownHeader key);
 
     void set_content_type(MimeType mime_type);
     void set_content_type(const std::string& mime_type);
 
+    // Replaces the body. Rvalue strings and shared buffers are not copied.
     void set_body(const std::string& body);
+    void set_body(std::string&& body);
+    void set_body(std::shared_ptr<const std::string> body);
+    void append_body(BodySegment segment);
     std::string get_body() const;
+    size_t body_size() const;
 
+    // Appends the status line and headers, including Content-Length unless the
+    // status forbids a body or Transfer-Encoding is set, to `out`.
+    void serialize_head(std::string& out);
+    // The same with `common`'s Server, Date and Connection lines after the status
+    // line; a Connection header set on the response is left out.
+    void serialize_head(std::string& out, const CommonHeaders& common, bool keep_alive);
+    BodySegments& body_segments();
     std::string to_string();
 private:
+    std::pmr::string make_text(std::string_view text) const;
+    void append_status_line(std::string& out) const;
+    void append_fields(std::string& out, bool with_connection);
+
     HttpStatus status_;
-    std::unordered_map<std::string, std::string> headers;
-    std::string body_;    
+    ResponseHeaders headers;
+    BodySegments body_;
 };
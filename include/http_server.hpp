@@ -6,6 +6,17 @@
 #include <thread>
 #include <vector>
 #include <memory>
+#include <string>
+
+// How accepted connections reach the event loops.
+enum class AcceptMode {
+    // One blocking accept loop on the calling thread hands sockets to loops round-robin.
+    ACCEPTOR_THREAD,
+    // Every loop binds its own SO_REUSEPORT socket and the kernel spreads connections.
+    REUSEPORT,
+    // One shared socket registered in every loop with EPOLLEXCLUSIVE.
+    EPOLL_EXCLUSIVE
+};
 
 class HttpServer {
 public:
@@ -13,17 +24,46 @@ public:
     ~HttpServer();
     bool start();
     void set_keep_alive_timeout(int seconds);
+    void set_timeouts(const TimeoutConfig& config);
+    // Stops accepting and wakes every loop so start() returns; async-signal-safe.
+    void stop();
+    void set_accept_mode(AcceptMode mode);
+    // Chosen per loop at start(); loops whose io_uring setup fails stay on epoll.
+    void set_io_backend(IoBackend backend);
+    // Loops that start() moved onto io_uring; fewer than requested fell back to epoll.
+    size_t get_io_uring_loops() const;
+    // Threads for routes registered with `blocking`; the pool is only started
+    // when such a route exists. Defaults to 4 per event loop.
+    void set_worker_threads(size_t count);
+    // Zeroes until start() has created the pool.
+    WorkerPoolStats get_worker_stats() const;
+    // Records per-route latency histograms, byte counts and status classes on every
+    // loop and serves them with the connection gauges as a GET route at `path`, in
+    // the Prometheus text format. Call before start().
+    void enable_metrics(const std::string& path = "/metrics");
+    // The same text the metrics route serves; lock-free, callable from any thread.
+    std::string get_metrics() const;
 
     static std::atomic<bool> running;
     static int socket_fd;
+    static HttpServer* active_server;
     Router router;
 
 private:
     void run();
+    int open_listener(bool reuse_port, bool non_blocking) const;
 
     int port;
-    int keep_alive_timeout;
+    AcceptMode accept_mode;
+    IoBackend io_backend;
+    std::atomic<size_t> io_uring_loops;
+    TimeoutConfig timeouts;
     size_t next_loop;
+    size_t worker_threads;
+    bool metrics_enabled;
     std::vector<std::unique_ptr<EventLoop>> event_loops;
     std::vector<std::thread> threads;
+    // Declared after the loops so it is destroyed, and its workers joined, before
+    // the loops they deliver replies to.
+    std::unique_ptr<WorkerPool> worker_pool;
 };
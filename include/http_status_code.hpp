@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 enum class HttpStatusCode {
     Continue = 100,
@@ -9,12 +10,15 @@ enum class HttpStatusCode {
     Accepted = 202,
     NonAuthoritativeInformation = 203,
     NoContent = 204,
+    PartialContent = 206,
     MovedPermanently = 301,
     Found = 302,
+    NotModified = 304,
     BadRequest = 400,
     Unauthorized = 401,
     Forbidden = 403,
     NotFound = 404,
+    RangeNotSatisfiable = 416,
     InternalServerError = 500,
     NotImplemented = 501
 };
@@ -27,7 +31,11 @@ public:
     HttpStatusCode get_status() const;
     unsigned int get_status_as_code() const;
 
+    // "200 OK"
     std::string as_string() const;
+    // "HTTP/1.1 200 OK\r\n", pre-rendered for every code above; empty for a code
+    // outside the enum.
+    std::string_view status_line() const;
 
     void set_status(HttpStatusCode code);
     void set_status(unsigned int code);
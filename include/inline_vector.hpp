@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Up to N elements inside the object, all of them on the heap beyond that. Once
+// spilled, it stays on the heap so a cleared vector reuses its capacity. Inline
+// elements are constructed only when added, so an allocator-aware element keeps
+// the allocator it was built with.
+template <typename T, size_t N>
+class InlineVector {
+public:
+    InlineVector() = default;
+
+    InlineVector(const InlineVector& other) {
+        for (const T& item : other) {
+            emplace_back(item);
+        }
+    }
+
+    InlineVector(InlineVector&& other) noexcept {
+        take(std::move(other));
+    }
+
+    InlineVector& operator=(const InlineVector& other) {
+        if (this != &other) {
+            clear();
+            for (const T& item : other) {
+                emplace_back(item);
+            }
+        }
+        return *this;
+    }
+
+    InlineVector& operator=(InlineVector&& other) noexcept {
+        if (this != &other) {
+            clear();
+            take(std::move(other));
+        }
+        return *this;
+    }
+
+    ~InlineVector() {
+        clear();
+    }
+
+    T* begin() { return data(); }
+    T* end() { return data() + size_; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size_; }
+    T& operator[](size_t index) { return data()[index]; }
+    const T& operator[](size_t index) const { return data()[index]; }
+    size_t size() const { return size_; }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ < N && !spilled_) [[likely]] {
+            return *new (inline_data() + size_++) T{std::forward<Args>(args)...};
+        }
+        if (!spilled_) {
+            heap_.reserve(N * 2);
+            for (size_t i = 0; i < size_; ++i) {
+                heap_.push_back(std::move(inline_data()[i]));
+                inline_data()[i].~T();
+            }
+            spilled_ = true;
+        }
+        ++size_;
+        return heap_.emplace_back(std::forward<Args>(args)...);
+    }
+
+    void erase(size_t index) {
+        T* items = data();
+        for (size_t i = index; i + 1 < size_; ++i) {
+            items[i] = std::move(items[i + 1]);
+        }
+        if (spilled_) {
+            heap_.pop_back();
+        } else {
+            items[size_ - 1].~T();
+        }
+        --size_;
+    }
+
+    void clear() {
+        if (spilled_) {
+            heap_.clear();
+        } else {
+            for (size_t i = 0; i < size_; ++i) {
+                inline_data()[i].~T();
+            }
+        }
+        size_ = 0;
+    }
+
+private:
+    T* inline_data() { return std::launder(reinterpret_cast<T*>(storage_)); }
+    const T* inline_data() const { return std::launder(reinterpret_cast<const T*>(storage_)); }
+    T* data() { return spilled_ ? heap_.data() : inline_data(); }
+    const T* data() const { return spilled_ ? heap_.data() : inline_data(); }
+
+    // Expects this vector to be empty.
+    void take(InlineVector&& other) {
+        if (other.spilled_) {
+            heap_ = std::move(other.heap_);
+            spilled_ = true;
+            size_ = other.size_;
+            other.size_ = 0;
+            return;
+        }
+        for (size_t i = 0; i < other.size_; ++i) {
+            emplace_back(std::move(other.inline_data()[i]));
+        }
+        other.clear();
+    }
+
+    alignas(T) std::byte storage_[N * sizeof(T)];
+    std::vector<T> heap_;
+    size_t size_ = 0;
+    bool spilled_ = false;
+};
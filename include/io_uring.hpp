@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <vector>
+
+// Minimal io_uring instance driven through the raw syscalls: one submission and
+// one completion ring plus a ring of provided receive buffers. Used by a single
+// EventLoop thread, so only the kernel side needs memory ordering.
+class IoUring {
+public:
+    // Throws std::runtime_error when the kernel lacks io_uring or a feature the
+    // event loop relies on (multishot receive and provided buffer rings). Each
+    // feature is probed; the kernel version is not consulted.
+    // `buffer_count` must be a power of two.
+    IoUring(unsigned entries, unsigned buffer_count, size_t buffer_size);
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // Multishot accept of non-blocking, close-on-exec sockets.
+    void accept_multishot(int fd, uint64_t user_data);
+    // Multishot receive into the provided buffers; see buffer() and recycle().
+    void recv_multishot(int fd, uint64_t user_data);
+    void sendmsg(int fd, const struct msghdr* message, uint64_t user_data);
+    void poll(int fd, uint32_t events, bool multishot, uint64_t user_data);
+    // Cancels the request submitted with `target`.
+    void cancel(uint64_t target, uint64_t user_data);
+
+    // Submits everything queued since the last call in one io_uring_enter and waits
+    // up to `timeout_ms` (-1: forever, 0: not at all) for a completion.
+    void submit_and_wait(int timeout_ms);
+    // Calls on_complete(cqe) for each completion ready, then frees their slots.
+    template <typename F>
+    void for_each_completion(F&& on_complete);
+
+    // The provided buffer a receive completion's flags point to.
+    static uint16_t buffer_id(uint32_t cqe_flags);
+    const char* buffer(uint16_t id) const;
+    // Hands a provided buffer back to the kernel once its bytes are consumed.
+    void recycle(uint16_t id);
+
+    static constexpr uint16_t BUFFER_GROUP = 0;
+
+private:
+    void release();
+    void probe_multishot_recv();
+    bool sq_full() const;
+    struct io_uring_sqe* next_sqe();
+    // Moves backlogged entries into free submission slots, oldest first.
+    void drain_backlog();
+    // Returns how many entries the kernel consumed.
+    unsigned enter(unsigned to_submit, unsigned min_complete, unsigned flags, const void* arg, size_t arg_size);
+
+    int ring_fd;
+    // Submission ring.
+    void* sq_map;
+    size_t sq_map_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned sq_local_tail;
+    // Entries before this one have been consumed by the kernel.
+    unsigned sq_submitted;
+    // Entries queued while the ring was full and the kernel would not take more,
+    // e.g. EBUSY while its completion ring is backed up. Later entries queue behind
+    // them so the kernel still sees them in order.
+    std::vector<struct io_uring_sqe> backlog;
+    // Completion ring; shares sq_map on kernels with IORING_FEAT_SINGLE_MMAP.
+    void* cq_map;
+    size_t cq_map_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    // Provided buffers: the ring the kernel takes them from and their memory. The
+    // ring is addressed as plain entries; struct io_uring_buf_ring's flexible array
+    // member is laid out differently when the header is compiled as C++.
+    struct io_uring_buf* buf_ring;
+    size_t buf_ring_size;
+    char* buffers;
+    unsigned buffer_count;
+    size_t buffer_size;
+    uint16_t buf_tail;
+};
+
+template <typename F>
+void IoUring::for_each_completion(F&& on_complete) {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        on_complete(cqes[head & cq_mask]);
+        ++head;
+        // Release each slot as it is handled so the callback may queue more work
+        // without the completion ring filling up.
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        if (head == tail) {
+            tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        }
+    }
+}
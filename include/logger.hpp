@@ -1,33 +1,199 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <format>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 enum class LogLevel {
-    DEBUG, 
-    INFO, 
-    WARNING, 
-    ERROR, 
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR,
     CRITICAL
 };
 
+// What a logging thread does when its ring buffer is full in async mode.
+enum class LogOverflowPolicy {
+    DROP,   // discard the new entry and count it
+    BLOCK   // yield until the writer thread frees a slot
+};
+
+struct AsyncLogConfig {
+    // Empty writes to stdout, otherwise entries are appended to this file.
+    std::string path;
+    // Entries per logging thread; rounded up to a power of two.
+    size_t ring_capacity = 4096;
+    LogOverflowPolicy overflow = LogOverflowPolicy::DROP;
+    std::chrono::milliseconds flush_interval{10};
+};
+
+struct LoggerStats {
+    uint64_t enqueued;
+    uint64_t written;
+    uint64_t dropped;
+};
+
 class Logger {
 public:
     static Logger& get_instance();
     void set_level(const LogLevel& lvl);
-    void log(LogLevel lvl, const std::string& message);
-    void debug(const std::string& message);
-    void info(const std::string& message);
-    void warning(const std::string& message);
-    void error(const std::string& message);
-    void critical(const std::string& message);
+    bool should_log(LogLevel lvl) const;
+
+    // Hands output to a background thread. Each logging thread gets its own
+    // single-producer ring, so log calls never take a lock or touch the output.
+    // Entries from different threads are written in per-thread order.
+    bool enable_async(const AsyncLogConfig& config = {});
+    // Drains every ring, stops the writer thread and returns to synchronous output.
+    void disable_async();
+    LoggerStats get_stats() const;
+
+    void log(LogLevel lvl, std::string_view message);
+    void debug(std::string_view message);
+    void info(std::string_view message);
+    void warning(std::string_view message);
+    void error(std::string_view message);
+    void critical(std::string_view message);
+
+    // Formatting overloads check the level before the message is built.
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void log(LogLevel lvl, std::format_string<Args...> fmt, Args&&... args);
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void debug(std::format_string<Args...> fmt, Args&&... args) {
+        log(LogLevel::DEBUG, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void info(std::format_string<Args...> fmt, Args&&... args) {
+        log(LogLevel::INFO, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void warning(std::format_string<Args...> fmt, Args&&... args) {
+        log(LogLevel::WARNING, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void error(std::format_string<Args...> fmt, Args&&... args) {
+        log(LogLevel::ERROR, fmt, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+        requires (sizeof...(Args) > 0)
+    void critical(std::format_string<Args...> fmt, Args&&... args) {
+        log(LogLevel::CRITICAL, fmt, std::forward<Args>(args)...);
+    }
+
 private:
+    static constexpr size_t MAX_MESSAGE_SIZE = 232;
+
+    struct LogRecord {
+        std::time_t time;
+        LogLevel level;
+        uint32_t length;
+        char text[MAX_MESSAGE_SIZE];
+    };
+
+    // Single-producer/single-consumer ring owned by one logging thread and
+    // drained by the writer thread.
+    class RecordRing {
+    public:
+        explicit RecordRing(size_t capacity);
+        LogRecord* try_acquire();
+        void publish();
+        template <typename F> size_t drain(F&& consume);
+    private:
+        std::vector<LogRecord> records;
+        size_t mask;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    // Marks the calling thread as an async producer for its lifetime, so
+    // disable_async can wait for it before the final drain. Converts to false
+    // when async mode is off; the caller then logs synchronously.
+    class AsyncProducer {
+    public:
+        explicit AsyncProducer(Logger& logger);
+        ~AsyncProducer();
+        AsyncProducer(const AsyncProducer&) = delete;
+        AsyncProducer& operator=(const AsyncProducer&) = delete;
+        explicit operator bool() const { return active; }
+    private:
+        Logger& logger;
+        bool active = false;
+    };
+
+    class TimestampCache {
+    public:
+        const std::string& format(std::time_t time);
+    private:
+        std::time_t cached_time = -1;
+        std::string cached;
+    };
+
     Logger();
-    ~Logger() = default;
+    ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
-    LogLevel min_level;
     std::string level_to_string(const LogLevel& lvl) const;
-    std::string format_log_entry(LogLevel level, const std::string& message);
+    std::string format_log_entry(LogLevel level, std::string_view message);
+    LogRecord* acquire_record(LogLevel level);
+    void publish_record();
+    void writer_loop();
+    size_t drain_rings(std::string& batch);
+
+    std::atomic<LogLevel> min_level;
     std::mutex mtx;
+    TimestampCache sync_timestamps;
+
+    std::atomic<bool> async_enabled{false};
+    // Threads between the async_enabled check and publishing their record.
+    std::atomic<uint32_t> async_producers{0};
+    // Only written while async mode is off and no producer can be reading it.
+    AsyncLogConfig async_config;
+    std::FILE* output = nullptr;
+    std::thread writer;
+    std::atomic<bool> writer_running{false};
+    std::mutex writer_mtx;
+    std::condition_variable writer_cv;
+    std::mutex rings_mtx;
+    std::vector<std::shared_ptr<RecordRing>> rings;
+    TimestampCache async_timestamps;
+
+    std::atomic<uint64_t> enqueued{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
 };
+
+template <typename... Args>
+    requires (sizeof...(Args) > 0)
+void Logger::log(LogLevel lvl, std::format_string<Args...> fmt, Args&&... args) {
+    if (!should_log(lvl)) {
+        return;
+    }
+    AsyncProducer producer(*this);
+    if (!producer) {
+        log(lvl, std::format(fmt, std::forward<Args>(args)...));
+        return;
+    }
+    LogRecord* record = acquire_record(lvl);
+    if (record == nullptr) {
+        return;
+    }
+    auto result = std::format_to_n(record->text, MAX_MESSAGE_SIZE, fmt, std::forward<Args>(args)...);
+    record->length = static_cast<uint32_t>(std::min<size_t>(result.size, MAX_MESSAGE_SIZE));
+    publish_record();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Monotonic nanoseconds for the metrics' latency measurements.
+inline uint64_t metrics_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A counter written by one thread and read by any. The owner updates it with a
+// plain load and store instead of a locked read-modify-write.
+class LocalCounter {
+public:
+    void add(uint64_t amount) {
+        value_.store(value_.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    void sub(uint64_t amount) {
+        value_.store(value_.load(std::memory_order_relaxed) - amount, std::memory_order_relaxed);
+    }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Log-linear latency histogram in the style of HdrHistogram: every power of two
+// of nanoseconds from 2^MIN_EXPONENT (about 1us) to 2^MAX_EXPONENT (about 69s)
+// is split into SUB_BUCKETS equal buckets, so a bucket is at most 25% wide
+// relative to its values. Shorter samples share the first bucket, longer ones the
+// last. Single writer, like LocalCounter.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 2;
+    static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned MIN_EXPONENT = 10;
+    static constexpr unsigned MAX_EXPONENT = 36;
+    static constexpr size_t BUCKETS = ((MAX_EXPONENT - MIN_EXPONENT) << SUB_BUCKET_BITS) + 2;
+
+    void record(uint64_t ns) {
+        counts_[bucket_of(ns)].add(1);
+        sum_ns_.add(ns);
+    }
+    uint64_t count(size_t bucket) const { return counts_[bucket].get(); }
+    uint64_t sum_ns() const { return sum_ns_.get(); }
+
+    static size_t bucket_of(uint64_t ns) {
+        if (ns < (uint64_t(1) << MIN_EXPONENT)) {
+            return 0;
+        }
+        unsigned exponent = static_cast<unsigned>(std::bit_width(ns)) - 1;
+        if (exponent >= MAX_EXPONENT) {
+            return BUCKETS - 1;
+        }
+        size_t sub = (ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return 1 + ((exponent - MIN_EXPONENT) << SUB_BUCKET_BITS) + sub;
+    }
+    // Exclusive upper bound of a bucket's values; the last bucket has none.
+    static uint64_t bucket_limit_ns(size_t bucket) {
+        if (bucket == 0) {
+            return uint64_t(1) << MIN_EXPONENT;
+        }
+        unsigned exponent = MIN_EXPONENT + static_cast<unsigned>((bucket - 1) >> SUB_BUCKET_BITS);
+        uint64_t sub = (bucket - 1) & (SUB_BUCKETS - 1);
+        return (uint64_t(1) << exponent) + ((sub + 1) << (exponent - SUB_BUCKET_BITS));
+    }
+
+private:
+    std::array<LocalCounter, BUCKETS> counts_;
+    LocalCounter sum_ns_;
+};
+
+// What one event loop has recorded for one route.
+struct RouteMetrics {
+    // Time spent parsing the request, running its handler (including the wait of a
+    // suspended coroutine or blocking handler) and from queuing the response until
+    // the socket has taken its last byte.
+    LatencyHistogram parse;
+    LatencyHistogram handler;
+    LatencyHistogram write;
+    LocalCounter bytes_in;
+    LocalCounter bytes_out;
+    // Responses per status class, 1xx to 5xx.
+    std::array<LocalCounter, 5> status_classes;
+
+    void record_status(unsigned code) {
+        if (code >= 100 && code < 600) {
+            status_classes[code / 100 - 1].add(1);
+        }
+    }
+};
+
+// Per-loop metric tables, written only by the loop's thread and read by whoever
+// renders them. Recording is off until enable() has sized the route table.
+class LoopMetrics {
+public:
+    // Call before the loop runs; `route_count` is the number of routes in the
+    // Router, and one more slot collects requests that matched none.
+    void enable(size_t route_count);
+    bool enabled() const { return routes_ != nullptr; }
+    // By Route::id.
+    RouteMetrics& route(size_t id) { return routes_[id]; }
+    RouteMetrics& unmatched() { return routes_[route_count_]; }
+    // Slots 0 to route_count(), the last being unmatched().
+    const RouteMetrics& slot(size_t index) const { return routes_[index]; }
+    size_t route_count() const { return route_count_; }
+
+    LocalCounter open_connections;
+    // Open connections waiting for their next request.
+    LocalCounter idle_connections;
+
+private:
+    std::unique_ptr<RouteMetrics[]> routes_;
+    size_t route_count_ = 0;
+};
+
+// Sums the tables of every loop and renders them in the Prometheus text format.
+// `routes` labels the route slots in registration order.
+std::string render_metrics(const std::vector<std::pair<RequestMethod, std::string>>& routes,
+                           const std::vector<const LoopMetrics*>& loops);
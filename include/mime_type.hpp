@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 enum class MimeType {
     TextPlain,          // text/plain
@@ -13,6 +14,13 @@ enum class MimeType {
     ImageJpeg,          // image/jpeg
     ImagePng,           // image/png
     ImageGif,           // image/gif
+    ImageSvg,           // image/svg+xml
+    ImageWebp,          // image/webp
+    ImageIcon,          // image/x-icon
+    TextCsv,            // text/csv
+    FontWoff,           // font/woff
+    FontWoff2,          // font/woff2
+    ApplicationWasm,    // application/wasm
     AudioMpeg,          // audio/mpeg
     VideoMp4,           // video/mp4
     MultipartFormData,  // multipart/form-data
@@ -20,3 +28,6 @@ enum class MimeType {
 };
 
 std::string mime_type_to_string(MimeType mime);
+// Infers the type from the file extension, ignoring case; unknown extensions map
+// to ApplicationOctetStream.
+MimeType mime_type_from_path(std::string_view path);
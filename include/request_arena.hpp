@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Memory for the responses built while one request is handled, owned by its
+// connection. Allocation is a pointer bump in a block kept across requests;
+// nothing is freed until the request is done, then everything is at once.
+class RequestArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    RequestArena();
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource();
+
+    // The arena of the request being handled on this thread, or the default
+    // resource outside of one (worker threads, coroutine handlers).
+    static std::pmr::memory_resource* current();
+
+    // Makes the arena current on this thread for a synchronous handler. When the
+    // scope ends, everything allocated from it is released, so objects built in
+    // it must be gone by then; copies of them use the default resource.
+    class Scope {
+    public:
+        explicit Scope(RequestArena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        RequestArena& arena;
+        std::pmr::memory_resource* previous;
+    };
+
+private:
+    std::unique_ptr<std::byte[]> block;
+    std::pmr::monotonic_buffer_resource buffer;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "response_cache.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct CoalescerStats {
+    uint64_t led;       // handler executions
+    uint64_t joined;    // requests answered by another request's execution
+};
+
+// Singleflight for identical requests. The first caller for a key runs the
+// handler; callers arriving while it runs get its serialized response instead of
+// running the handler again. Event loops do not wait for it: they take the
+// in-flight call and subscribe to it. Workers may block on it, for no longer
+// than running the handler themselves would have. Shared by every event loop and
+// worker.
+class RequestCoalescer {
+public:
+    using Result = std::shared_ptr<const CachedResponse>;
+
+    // One execution of a handler and the callers that joined it.
+    class Flight {
+    public:
+        // Blocks until the leader finishes.
+        Result wait();
+        // Calls `on_done` once the leader finishes: right away on this thread if it
+        // already has, otherwise on the leader's thread, which must not be held up.
+        void subscribe(std::function<void()> on_done);
+        // Only meaningful once finished.
+        Result result() const;
+
+    private:
+        friend class RequestCoalescer;
+
+        void finish(Result value);
+
+        mutable std::mutex mtx;
+        std::condition_variable done_cv;
+        bool done = false;
+        Result value;
+        std::vector<std::function<void()>> subscribers;
+    };
+
+    struct Outcome {
+        Result response;
+        // True for the caller whose `produce` ran.
+        bool leader;
+        // Without `wait`, a follower gets the call it joined here instead of a response.
+        std::shared_ptr<Flight> joined;
+    };
+
+    // Runs `produce`, a callable returning Result, unless a call for `key` is
+    // already in flight. A follower then waits for that call's result, or with
+    // `wait` false returns at once with the call in `joined`. A nullptr result, or
+    // an exception in the leader, leaves followers with a nullptr response, and
+    // they handle the request themselves.
+    template <typename Produce>
+    Outcome run(const std::string& key, Produce&& produce, bool wait = true) {
+        auto [flight, leader] = join(key);
+        if (!leader) {
+            if (!wait) {
+                return Outcome{nullptr, false, std::move(flight)};
+            }
+            return Outcome{flight->wait(), false, nullptr};
+        }
+        Result result;
+        try {
+            result = std::forward<Produce>(produce)();
+        } catch (...) {
+            finish(key, *flight, nullptr);
+            throw;
+        }
+        finish(key, *flight, result);
+        return Outcome{std::move(result), true, nullptr};
+    }
+
+    CoalescerStats get_stats() const;
+
+private:
+    // Returns the in-flight call for `key`, or registers and returns a new one with
+    // the caller as its leader.
+    std::pair<std::shared_ptr<Flight>, bool> join(const std::string& key);
+    void finish(const std::string& key, Flight& flight, Result result);
+
+    std::mutex mtx;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> in_flight;
+    std::atomic<uint64_t> led{0};
+    std::atomic<uint64_t> joined{0};
+};
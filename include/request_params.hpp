@@ -0,0 +1,75 @@
+#pragma once
+
+#include "inline_vector.hpp"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using RequestParam = std::pair<std::string_view, std::string_view>;
+
+// Appends `encoded` to `out` with %XX escapes decoded and, for query strings, '+'
+// as a space. Malformed escapes are kept as they are.
+void append_url_decoded(std::string& out, std::string_view encoded, bool plus_as_space);
+
+// Parameters captured by the Router. Names point into the route tree and values
+// into the request path, so filling it allocates nothing.
+class PathParams {
+public:
+    static constexpr size_t MAX_PARAMS = 16;
+
+    std::optional<std::string_view> get(std::string_view name) const;
+    size_t size() const { return size_; }
+    void clear() { size_ = 0; }
+
+    RequestParam* begin() { return items_.data(); }
+    RequestParam* end() { return items_.data() + size_; }
+    const RequestParam* begin() const { return items_.data(); }
+    const RequestParam* end() const { return items_.data() + size_; }
+
+private:
+    friend class RouteTree;
+
+    std::array<RequestParam, MAX_PARAMS> items_;
+    size_t size_ = 0;
+};
+
+// The query string of a request, split and decoded on first access since most
+// handlers read one parameter or none. Keys and values without escapes are views
+// into the query itself; escaped ones are decoded into a buffer held here, which
+// keeps its capacity between requests.
+class QueryParams {
+public:
+    QueryParams() = default;
+    // A copy only takes the raw query and splits it again when read, so it never
+    // points into the other object's decode buffer.
+    QueryParams(const QueryParams& other);
+    QueryParams& operator=(const QueryParams& other);
+
+    // Starts over with `query`, the text after '?' without the '?'.
+    void assign(std::string_view query);
+    void clear();
+    std::string_view query() const { return query_; }
+
+    // A key given more than once yields its last value.
+    std::optional<std::string_view> get(std::string_view key) const;
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    // Parameters in the order they appear, repeats included.
+    const RequestParam* begin() const;
+    const RequestParam* end() const;
+
+private:
+    static constexpr size_t INLINE_PARAMS = 8;
+
+    void split() const;
+    std::string_view decode(std::string_view encoded) const;
+
+    std::string_view query_;
+    mutable bool split_ = false;
+    mutable InlineVector<RequestParam, INLINE_PARAMS> items_;
+    mutable std::string decoded_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include "http_response.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A response stored as the bytes sent on the wire, minus the Date and Connection
+// headers, which differ per send. Those go in at `status_line_size`, with Server
+// unless the handler set its own.
+struct CachedResponse {
+    std::shared_ptr<const std::string> wire;
+    size_t status_line_size;
+    bool own_server;
+    HttpStatusCode status;
+    std::string etag;
+    std::string last_modified;
+    // False for non-200 responses and "Cache-Control: no-store"; those may still
+    // be shared between coalesced requests but are never stored.
+    bool cacheable;
+};
+
+struct ResponseCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t bytes;
+};
+
+// Shared by every event loop. Keys are spread over lock-striped shards, each with
+// its own LRU list and an equal part of the memory cap.
+class ResponseCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+    explicit ResponseCache(size_t capacity_bytes = DEFAULT_CAPACITY);
+
+    // Method, path, query parameters in sorted order and the values of
+    // `key_headers`, so "?b=2&a=1" and "?a=1&b=2" share an entry.
+    static std::string make_key(const HttpRequest& request, const std::vector<std::string>& key_headers = {});
+    // Serializes a response, giving a 200 an ETag derived from its bytes if the
+    // handler did not set one. Returns nullptr for file bodies.
+    static std::shared_ptr<const CachedResponse> serialize(HttpResponse& response);
+    // Returns nullptr on a miss or an expired entry.
+    std::shared_ptr<const CachedResponse> find(const std::string& key);
+    // Stores a cacheable response for `ttl`; entries too large for a shard are
+    // skipped.
+    void insert(const std::string& key, std::shared_ptr<const CachedResponse> response,
+                std::chrono::milliseconds ttl);
+    // Evicts least recently used entries until the new cap is met.
+    void set_capacity(size_t capacity_bytes);
+    void clear();
+    ResponseCacheStats get_stats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const CachedResponse> response;
+        std::chrono::steady_clock::time_point expires;
+        size_t bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex mtx;
+        // Most recently used first.
+        std::list<Entry> lru;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shard_for(const std::string& key);
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+    void evict_to(Shard& shard, size_t limit);
+
+    std::array<Shard, SHARD_COUNT> shards;
+    std::atomic<size_t> shard_capacity;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+};
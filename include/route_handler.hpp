@@ -0,0 +1,107 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include "http_response.hpp"
+#include <concepts>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature>
+class BasicRouteHandler;
+
+// Type-erased request handler. Dispatch is a single call through a function pointer
+// to a thunk in which the concrete callable is known, so the handler body can be
+// inlined there. Handlers are stored once in the Router and called by reference.
+template <typename Result, typename Arg>
+class BasicRouteHandler<Result(Arg)> {
+public:
+    using Function = Result (*)(Arg);
+
+    // Owns a copy of the callable, allocated once at registration.
+    template <typename F>
+        requires (!std::same_as<std::decay_t<F>, BasicRouteHandler>) &&
+                 std::is_invocable_r_v<Result, const std::decay_t<F>&, Arg>
+    BasicRouteHandler(F&& callable)
+        : invoke_(&invoke_object<std::decay_t<F>>),
+          context_(new std::decay_t<F>(std::forward<F>(callable))),
+          destroy_(&destroy_object<std::decay_t<F>>) {}
+
+    BasicRouteHandler(BasicRouteHandler&& other) noexcept
+        : invoke_(other.invoke_), context_(other.context_), destroy_(other.destroy_) {
+        other.context_ = nullptr;
+        other.destroy_ = nullptr;
+    }
+
+    BasicRouteHandler& operator=(BasicRouteHandler&& other) noexcept {
+        if (this != &other) {
+            reset();
+            invoke_ = other.invoke_;
+            context_ = other.context_;
+            destroy_ = other.destroy_;
+            other.context_ = nullptr;
+            other.destroy_ = nullptr;
+        }
+        return *this;
+    }
+
+    BasicRouteHandler(const BasicRouteHandler&) = delete;
+    BasicRouteHandler& operator=(const BasicRouteHandler&) = delete;
+
+    ~BasicRouteHandler() {
+        reset();
+    }
+
+    // Binds a function known at compile time; the call is a direct call inside the thunk.
+    template <Function Fn>
+    static BasicRouteHandler bind() {
+        return BasicRouteHandler(&invoke_function<Fn>, nullptr, nullptr);
+    }
+
+    // Refers to a callable owned elsewhere, which must outlive the Router.
+    template <typename F>
+        requires std::is_invocable_r_v<Result, const F&, Arg>
+    static BasicRouteHandler ref(const F& callable) {
+        return BasicRouteHandler(&invoke_object<F>, &callable, nullptr);
+    }
+
+    Result operator()(Arg arg) const {
+        return invoke_(context_, std::forward<Arg>(arg));
+    }
+
+private:
+    using Invoker = Result (*)(const void*, Arg);
+    using Destroyer = void (*)(const void*);
+
+    BasicRouteHandler(Invoker invoke, const void* context, Destroyer destroy)
+        : invoke_(invoke), context_(context), destroy_(destroy) {}
+
+    void reset() {
+        if (destroy_ != nullptr) {
+            destroy_(context_);
+        }
+        context_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+    template <typename F>
+    static Result invoke_object(const void* context, Arg arg) {
+        return (*static_cast<const F*>(context))(std::forward<Arg>(arg));
+    }
+
+    template <Function Fn>
+    static Result invoke_function(const void*, Arg arg) {
+        return Fn(std::forward<Arg>(arg));
+    }
+
+    template <typename F>
+    static void destroy_object(const void* context) {
+        delete static_cast<const F*>(context);
+    }
+
+    Invoker invoke_;
+    const void* context_;
+    Destroyer destroy_;
+};
+
+using RouteHandler = BasicRouteHandler<HttpResponse(const HttpRequest&)>;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "async_handler.hpp"
+#include "http_request_parser.hpp"
+#include "route_handler.hpp"
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Per-route behaviour beyond the handler itself.
+struct RouteOptions {
+    // GET and HEAD responses are served from the Router's ResponseCache for this
+    // long; zero disables caching.
+    std::chrono::milliseconds cache_ttl{0};
+    // Identical GET and HEAD requests arriving while the handler runs share its
+    // response instead of running it again.
+    bool coalesce = false;
+    // Request headers that select a different response, e.g. "Accept-Language";
+    // their values become part of the cache and coalescing key.
+    std::vector<std::string> key_headers;
+    // The handler may block (database calls, file or network I/O), so it runs on
+    // the server's worker pool instead of the event loop.
+    bool blocking = false;
+};
+
+// Compressed radix tree over route patterns for one request method. Patterns are
+// literal text plus whole-segment parameters: `{name}` matches one non-empty
+// segment and a trailing `{name...}` matches the rest of the path. When several
+// routes could match, static text wins over a parameter, which wins over a tail.
+class RouteTree {
+public:
+    struct Route {
+        std::string pattern;
+        RouteHandler handler;
+        RouteOptions options;
+        // Set for coroutine handlers, which the connection runs in place of `handler`.
+        std::optional<AsyncRouteHandler> async_handler;
+        // Position in the Router's registration order, which indexes its metrics.
+        size_t id = 0;
+    };
+
+    RouteTree();
+    // Throws std::invalid_argument for malformed patterns, a pattern that is
+    // already registered, or a parameter whose name differs from one registered
+    // at the same position.
+    Route& insert(const std::string& pattern, RouteHandler handler, const RouteOptions& options = {});
+    const Route* find(std::string_view path, PathParams& captures) const;
+
+private:
+    enum class NodeKind {
+        STATIC, PARAM, CATCH_ALL
+    };
+
+    struct Node {
+        NodeKind kind;
+        // Literal text for static nodes, the parameter name otherwise.
+        std::string label;
+        // Static children, each starting with a distinct byte.
+        std::vector<std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> param_child;
+        std::unique_ptr<Node> catch_all_child;
+        std::unique_ptr<Route> route;
+    };
+
+    Node* insert_static(Node* node, std::string_view text);
+    static const Route* match(const Node* node, std::string_view path, PathParams& captures);
+
+    std::unique_ptr<Node> root;
+};
@@ -1,42 +1,89 @@
 #pragma once
 
+#include "async_handler.hpp"
 #include "http_request_parser.hpp"
 #include "http_response.hpp"
-#include <functional>
-#include <optional>
+#include "request_coalescer.hpp"
+#include "response_cache.hpp"
+#include "route_handler.hpp"
+#include "route_tree.hpp"
+#include "static_files.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-struct RoutePattern {
-    std::string original_pattern; 
-    std::vector<std::string> segments;
-    std::vector<std::string> param_names;
-    std::function<HttpResponse(const HttpRequest&)> handler;
-    
-    RoutePattern(const std::string& pattern, std::function<HttpResponse(const HttpRequest&)>& handler);
-    bool matches(const std::string& path, std::map<std::string, std::string>& params) const;
-private:
-    void parse_pattern(const std::string& pattern);
-    bool is_param_segment(const std::string& segment) const;
-    std::string extract_param_name(const std::string& segment) const;
-};
+using route = std::pair<RequestMethod, std::string>;
 
-struct RouteHash {
-    size_t operator() (const std::pair<RequestMethod, std::string>& pair) const;
+// The outcome of running a route: a serialized response shared through the cache
+// or coalescer when `shared` is set, otherwise `response`.
+struct RouteReply {
+    HttpResponse response;
+    std::shared_ptr<const CachedResponse> shared;
+    // Instead of either, when dispatch was told not to wait and the request joined
+    // an identical coalesced one still running. Pass it to finish_joined once that
+    // call is done.
+    std::shared_ptr<RequestCoalescer::Flight> joined;
 };
 
-using route = std::pair<RequestMethod, std::string>;
-using routes_iterator = std::unordered_map<route, std::function<HttpResponse(const HttpRequest&)>, RouteHash>::iterator;
-
 class Router {
 private:
-    std::unordered_map<route, std::function<HttpResponse(const HttpRequest&)>, RouteHash> exact_routes;
-    std::unordered_map<RequestMethod, std::vector<RoutePattern>> param_routes;
-    static bool has_parameters(const std::string& route_pattern);
+    std::unordered_map<RequestMethod, RouteTree> routes;
+    std::vector<route> registered;
+    ResponseCache response_cache;
+    RequestCoalescer coalescer;
+    bool blocking_routes = false;
+
+    RouteTree::Route& insert(RequestMethod method, const std::string& route, RouteHandler handler,
+                             const RouteOptions& options);
+    bool serve_shared(const RouteTree::Route& route, HttpRequest& request, RouteReply& reply, bool wait);
+    std::shared_ptr<const CachedResponse> produce_shared(const RouteTree::Route& route, HttpRequest& request,
+                                                         const std::string& key, RouteReply& reply);
+    void reply_shared(HttpRequest& request, std::shared_ptr<const CachedResponse> shared, RouteReply& reply);
 public:
     Router() = default;
-    void add_route(RequestMethod method, const std::string& route, std::function<HttpResponse(const HttpRequest&)> handler);
-    std::optional<routes_iterator> get_route(route route);
-    std::optional<std::function<HttpResponse(const HttpRequest&)>> match_route(RequestMethod method, const std::string& path, HttpRequest& request);
+    // Throws std::invalid_argument if the route conflicts with one already added.
+    void add_route(RequestMethod method, const std::string& route, RouteHandler handler,
+                   const RouteOptions& options = {});
+    // Registers a plain function without any type erasure beyond the dispatch thunk:
+    // router.add_route<&get_users>(RequestMethod::GET, "/users");
+    template <RouteHandler::Function Fn>
+    void add_route(RequestMethod method, const std::string& route, const RouteOptions& options = {}) {
+        add_route(method, route, RouteHandler::bind<Fn>(), options);
+    }
+    // Registers a coroutine handler, run on the connection's event loop; see
+    // AsyncResponse. Route options do not apply to it.
+    void add_async_route(RequestMethod method, const std::string& route, AsyncRouteHandler handler);
+    template <AsyncRouteHandler::Function Fn>
+    void add_async_route(RequestMethod method, const std::string& route) {
+        add_async_route(method, route, AsyncRouteHandler::bind<Fn>());
+    }
+    // Serves files below `root` for GET and HEAD requests under `prefix`, e.g.
+    // add_static("/assets", "./public") maps "/assets/app.js" to "./public/app.js".
+    void add_static(const std::string& prefix, const std::string& root, const StaticFilesConfig& config = {});
+    // Looks up a registered pattern verbatim, e.g. "/users/{id}".
+    const RouteHandler* get_route(route route) const;
+    // Returns the registered handler, valid for the Router's lifetime, or nullptr.
+    const RouteHandler* match_route(RequestMethod method, std::string_view path, HttpRequest& request) const;
+    // Like match_route, but also exposes the route's options.
+    const RouteTree::Route* match(RequestMethod method, std::string_view path, HttpRequest& request) const;
+    // Runs a matched route's handler, going through the response cache and the
+    // coalescer when its options ask for them, and applies conditional and range
+    // headers. Thread-safe, so blocking routes can run it on the worker pool.
+    // Event loops pass `wait` false: a request that joins an identical coalesced
+    // one then comes back with RouteReply::joined instead of blocking the loop.
+    RouteReply dispatch(const RouteTree::Route& route, HttpRequest& request, bool wait = true);
+    // Completes a reply left with `joined` once that call has finished, running
+    // the handler if its response could not be shared.
+    void finish_joined(const RouteTree::Route& route, HttpRequest& request, RouteReply& reply);
+    // Every method and pattern registered, indexed by RouteTree::Route::id.
+    const std::vector<route>& get_routes() const;
+    // True once any route has been registered with `blocking`.
+    bool has_blocking_routes() const;
+    // Holds the responses of routes registered with a cache_ttl.
+    ResponseCache& get_response_cache();
+    // Joins identical in-flight requests on routes registered with coalesce.
+    RequestCoalescer& get_coalescer();
 };
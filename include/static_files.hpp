@@ -0,0 +1,39 @@
+#pragma once
+
+#include "file_cache.hpp"
+#include "http_request_parser.hpp"
+#include "http_response.hpp"
+#include <chrono>
+#include <string>
+#include <string_view>
+
+struct StaticFilesConfig {
+    // How long a cached descriptor and its stat result are trusted before the
+    // file is checked again.
+    std::chrono::milliseconds cache_ttl{std::chrono::seconds(2)};
+    size_t max_open_files = 1024;
+    // Served for requests naming a directory; empty to disable.
+    std::string index_file = "index.html";
+};
+
+// Serves files below a root directory. Mounted with Router::add_static, which
+// captures the file path in the `path` parameter. Paths containing ".." segments
+// are rejected.
+class StaticFiles {
+public:
+    StaticFiles(std::string root, const StaticFilesConfig& config = {});
+
+    HttpResponse operator()(const HttpRequest& request) const;
+
+private:
+    static bool is_safe_path(std::string_view path);
+    static std::string decode_path(std::string_view encoded);
+    // The named file, or the index file when `relative` is empty or ends in a slash.
+    std::shared_ptr<const OpenFile> find_file(const std::string& relative) const;
+    // True if `relative` names a directory, without its trailing slash, that has an index file.
+    bool is_directory_index(const std::string& relative) const;
+
+    std::string root;
+    std::string index_file;
+    mutable FileCache cache;
+};
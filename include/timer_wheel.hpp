@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Intrusive timer entry, embedded in the object that owns the deadline.
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    void* context = nullptr;
+    uint64_t expires_tick = 0;
+    uint8_t level = 0;
+    uint8_t slot = 0;
+    bool armed = false;
+};
+
+// Hierarchical timing wheel: four levels of 64 slots, each level 64 times coarser
+// than the one below. Arming, re-arming and cancelling are O(1); timers in upper
+// levels cascade down as time reaches their slot. Times are in milliseconds on a
+// caller-supplied monotonic clock and are rounded up to whole ticks.
+class TimerWheel {
+public:
+    explicit TimerWheel(uint64_t tick_ms = 10, uint64_t now_ms = 0);
+
+    void arm(TimerNode& node, uint64_t expires_ms);
+    void cancel(TimerNode& node);
+    // Moves time forward and calls on_expired(node) for each timer that is due.
+    // Expired nodes are disarmed before the callback, which may re-arm them.
+    template <typename F>
+    void advance(uint64_t now_ms, F&& on_expired);
+    // Milliseconds until the earliest timer may fire, or -1 when none are armed.
+    int next_timeout_ms(uint64_t now_ms) const;
+    size_t size() const;
+
+private:
+    static constexpr unsigned LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+
+    struct Slot {
+        TimerNode* head = nullptr;
+    };
+
+    void insert(TimerNode& node);
+    void unlink(TimerNode& node);
+    void cascade(unsigned level);
+
+    uint64_t tick_ms;
+    uint64_t current_tick;
+    size_t count;
+    std::array<std::array<Slot, SLOTS>, LEVELS> wheels;
+    std::array<uint64_t, LEVELS> occupied;
+};
+
+template <typename F>
+void TimerWheel::advance(uint64_t now_ms, F&& on_expired) {
+    uint64_t target_tick = now_ms / tick_ms;
+    if (count == 0) {
+        current_tick = target_tick > current_tick ? target_tick : current_tick;
+        return;
+    }
+    while (current_tick < target_tick) {
+        ++current_tick;
+        for (unsigned level = LEVELS - 1; level > 0; --level) {
+            if ((current_tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+        Slot& slot = wheels[0][current_tick & (SLOTS - 1)];
+        while (slot.head != nullptr) {
+            TimerNode& node = *slot.head;
+            unlink(node);
+            on_expired(node);
+        }
+        if (count == 0) {
+            current_tick = target_tick;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "http_request_parser.hpp"
+#include "router.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class EventLoop;
+
+// A request for a blocking route on its way to the worker pool and back, or one
+// parked on a coalesced call (reply.joined) until that call is done. It owns a
+// copy of the request bytes, with `request` pointing into `data`, so it stays
+// valid even if the connection is closed while the handler runs.
+struct DeferredRequest {
+    std::string data;
+    HttpRequest request;
+    const RouteTree::Route* route = nullptr;
+    // The loop and connection the reply is delivered to.
+    EventLoop* loop = nullptr;
+    uint64_t handle = 0;
+    std::chrono::steady_clock::time_point queued;
+    // Outlives the request arena that may be current where the job is created.
+    RouteReply reply{HttpResponse(std::pmr::get_default_resource()), nullptr, nullptr};
+};
+
+struct WorkerPoolStats {
+    size_t queue_depth;         // requests waiting for a worker right now
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t total_wait_us;     // summed time between submit and a worker picking it up
+    uint64_t max_wait_us;
+};
+
+// Runs blocking handlers off the event loops. Each worker has its own deque:
+// submissions are spread round-robin, a worker takes from the front of its own
+// deque and, once that is empty, steals from the back of the others, so a worker
+// stuck on a slow handler does not strand the requests queued behind it.
+// Replies are handed to the owning EventLoop, which picks them up via eventfd.
+class WorkerPool {
+public:
+    WorkerPool(Router& router, size_t threads);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Thread-safe.
+    void submit(std::unique_ptr<DeferredRequest> job);
+    WorkerPoolStats get_stats() const;
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<std::unique_ptr<DeferredRequest>> jobs;
+    };
+
+    void run(size_t index);
+    std::unique_ptr<DeferredRequest> take(size_t index);
+    static void set_internal_error(RouteReply& reply);
+
+    Router& router;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> queued{0};
+    std::mutex idle_mtx;
+    std::condition_variable idle_cv;
+    bool stopping = false;
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> total_wait_us{0};
+    std::atomic<uint64_t> max_wait_us{0};
+};
@@ -8,8 +8,8 @@ int main() {
     HttpServer h;
     h.router.add_route(RequestMethod::GET, "/hello/{id}", [](const HttpRequest& request) {
         HttpResponse response;
-        int id = std::stoi(request.get_path_param("id").value_or("-1"));
-        std::string value = request.get_query_param("key").value_or("no value");
+        int id = std::stoi(std::string(request.get_path_param("id").value_or("-1")));
+        std::string_view value = request.get_query_param("key").value_or("no value");
         std::string response_body = std::format("{{ \"message\": \"id is {} and key is {}\" }}", id, value);
         for(const auto& [key, val]: request.query_params) {
             std::cout << key << '=' << val << std::endl;
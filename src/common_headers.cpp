@@ -0,0 +1,34 @@
+#include "../include/common_headers.hpp"
+#include "../include/http_date.hpp"
+
+CommonHeaders::CommonHeaders(): time_(-1) {
+    std::string lines = "Server: " + std::string(SERVER_NAME) + "\r\nDate: " + std::string(DATE_SIZE, ' ') + "\r\n";
+    keep_alive_lines_ = lines + "Connection: keep-alive\r\n";
+    close_lines_ = lines + "Connection: close\r\n";
+    refresh(std::time(nullptr));
+}
+
+void CommonHeaders::refresh(std::time_t now) {
+    if (now == time_) {
+        return;
+    }
+    time_ = now;
+    std::string date = format_http_date(now);
+    keep_alive_lines_.replace(DATE_OFFSET, DATE_SIZE, date);
+    close_lines_.replace(DATE_OFFSET, DATE_SIZE, date);
+}
+
+void CommonHeaders::append_to(std::string& out, bool keep_alive, bool with_server, bool with_date) const {
+    std::string_view lines = keep_alive ? keep_alive_lines_ : close_lines_;
+    if (with_server && with_date) [[likely]] {
+        out += lines;
+        return;
+    }
+    if (with_server) {
+        out += lines.substr(0, SERVER_LINE_SIZE);
+    }
+    if (with_date) {
+        out += lines.substr(SERVER_LINE_SIZE, DATE_LINE_SIZE);
+    }
+    out += lines.substr(SERVER_LINE_SIZE + DATE_LINE_SIZE);
+}
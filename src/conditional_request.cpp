@@ -0,0 +1,246 @@
+#include "../include/conditional_request.hpp"
+#include "../include/http_date.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// More ranges than this are served as a plain 200 rather than a large multipart
+// body built from tiny pieces.
+constexpr size_t MAX_RANGES = 16;
+
+struct ByteRange {
+    uint64_t first;
+    uint64_t last;
+};
+
+enum class RangeResult {
+    IGNORE,         // malformed or not worth honoring: send the full body
+    SATISFIABLE,
+    UNSATISFIABLE
+};
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+std::optional<uint64_t> parse_offset(std::string_view text) {
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || ec != std::errc() || ptr != text.data() + text.size()) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+bool is_weak(std::string_view tag) {
+    return tag.starts_with("W/");
+}
+
+std::string_view opaque_tag(std::string_view tag) {
+    return is_weak(tag) ? tag.substr(2) : tag;
+}
+
+// If-None-Match uses the weak comparison: W/"x" matches "x".
+bool matches_any_tag(std::string_view list, std::string_view etag) {
+    if (trim(list) == "*") {
+        return true;
+    }
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view tag = trim(list.substr(0, comma));
+        if (!tag.empty() && opaque_tag(tag) == opaque_tag(etag)) {
+            return true;
+        }
+        list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+    }
+    return false;
+}
+
+// If-Range needs a strong validator: an exactly matching strong ETag, or the
+// Last-Modified date itself.
+bool if_range_allows(const HttpRequest& request, const HttpResponse& response) {
+    auto if_range = request.get_header(KnownHeader::IfRange);
+    if (!if_range) {
+        return true;
+    }
+    std::string_view validator = trim(*if_range);
+    if (validator.starts_with('"') || is_weak(validator)) {
+        auto etag = response.get_header(KnownHeader::ETag);
+        return etag && !is_weak(validator) && !is_weak(*etag) && validator == *etag;
+    }
+    auto last_modified = response.get_header(KnownHeader::LastModified);
+    return last_modified && validator == *last_modified;
+}
+
+RangeResult parse_ranges(std::string_view header, uint64_t size, std::vector<ByteRange>& ranges) {
+    header = trim(header);
+    if (!header.starts_with("bytes=")) {
+        return RangeResult::IGNORE;
+    }
+    header.remove_prefix(6);
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        std::string_view spec = trim(header.substr(0, comma));
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+        if (spec.empty()) {
+            continue;
+        }
+        size_t dash = spec.find('-');
+        if (dash == std::string_view::npos) {
+            return RangeResult::IGNORE;
+        }
+        std::string_view first_text = spec.substr(0, dash);
+        std::string_view last_text = spec.substr(dash + 1);
+        ByteRange range;
+        if (first_text.empty()) {
+            // "-N": the final N bytes.
+            auto suffix = parse_offset(last_text);
+            if (!suffix) {
+                return RangeResult::IGNORE;
+            }
+            if (*suffix == 0 || size == 0) {
+                continue;
+            }
+            range = {size - std::min(*suffix, size), size - 1};
+        } else {
+            auto first = parse_offset(first_text);
+            std::optional<uint64_t> last = last_text.empty() ? std::optional<uint64_t>(UINT64_MAX) : parse_offset(last_text);
+            if (!first || !last || *last < *first) {
+                return RangeResult::IGNORE;
+            }
+            if (*first >= size) {
+                continue;
+            }
+            range = {*first, std::min(*last, size - 1)};
+        }
+        if (ranges.size() == MAX_RANGES) {
+            return RangeResult::IGNORE;
+        }
+        ranges.push_back(range);
+    }
+    if (ranges.empty()) {
+        return RangeResult::UNSATISFIABLE;
+    }
+    // Overlapping ranges would let a small request fan out into a huge response.
+    std::vector<ByteRange> sorted = ranges;
+    std::sort(sorted.begin(), sorted.end(), [](const ByteRange& a, const ByteRange& b) { return a.first < b.first; });
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        if (sorted[i].first <= sorted[i - 1].last) {
+            return RangeResult::IGNORE;
+        }
+    }
+    return RangeResult::SATISFIABLE;
+}
+
+// Appends the segments covering [first, last] of `body` to `out`.
+void append_slice(const BodySegments& body, const ByteRange& range, BodySegments& out) {
+    uint64_t position = 0;
+    for (const auto& segment: body) {
+        uint64_t begin = position;
+        uint64_t end = position + segment.size();
+        position = end;
+        if (end <= range.first || begin > range.last) {
+            continue;
+        }
+        uint64_t from = std::max(range.first, begin);
+        uint64_t to = std::min(range.last + 1, end);
+        out.push_back(segment.slice(from - begin, static_cast<size_t>(to - from)));
+    }
+}
+
+std::string content_range(const ByteRange& range, uint64_t size) {
+    return std::format("bytes {}-{}/{}", range.first, range.last, size);
+}
+
+std::string next_boundary() {
+    static std::atomic<uint64_t> counter{0};
+    return std::format("bcpp-{:016x}", counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+void send_ranges(HttpResponse& response, const std::vector<ByteRange>& ranges, uint64_t size) {
+    BodySegments body = std::move(response.body_segments());
+    BodySegments& parts = response.body_segments();
+    parts.clear();
+    response.set_status(HttpStatusCode::PartialContent);
+    response.remove_header(KnownHeader::ContentLength);
+    if (ranges.size() == 1) {
+        response.set_header(KnownHeader::ContentRange, content_range(ranges.front(), size));
+        append_slice(body, ranges.front(), parts);
+        return;
+    }
+
+    std::string boundary = next_boundary();
+    std::string part_type = response.get_header(KnownHeader::ContentType).value_or("application/octet-stream");
+    response.set_header(KnownHeader::ContentType, "multipart/byteranges; boundary=" + boundary);
+    for (const auto& range: ranges) {
+        parts.emplace_back(std::format("\r\n--{}\r\nContent-Type: {}\r\nContent-Range: {}\r\n\r\n",
+                                       boundary, part_type, content_range(range, size)));
+        append_slice(body, range, parts);
+    }
+    parts.emplace_back(std::format("\r\n--{}--\r\n", boundary));
+}
+
+}
+
+bool is_not_modified(const HttpRequest& request, std::string_view etag, std::string_view last_modified) {
+    if (auto if_none_match = request.get_header(KnownHeader::IfNoneMatch)) {
+        // When present it decides alone; If-Modified-Since is ignored.
+        return !etag.empty() && matches_any_tag(*if_none_match, etag);
+    }
+    auto if_modified_since = request.get_header(KnownHeader::IfModifiedSince);
+    if (!if_modified_since || last_modified.empty()) {
+        return false;
+    }
+    auto since = parse_http_date(*if_modified_since);
+    auto modified = parse_http_date(last_modified);
+    return since && modified && *modified <= *since;
+}
+
+void apply_conditional_request(const HttpRequest& request, HttpResponse& response) {
+    bool is_get = request.method == RequestMethod::GET;
+    if ((!is_get && request.method != RequestMethod::HEAD) ||
+        response.get_status().get_status() != HttpStatusCode::OK) {
+        return;
+    }
+    if (is_not_modified(request, response.get_header(KnownHeader::ETag).value_or(""),
+                        response.get_header(KnownHeader::LastModified).value_or(""))) {
+        response.set_status(HttpStatusCode::NotModified);
+        response.body_segments().clear();
+        response.remove_header(KnownHeader::ContentLength);
+        return;
+    }
+
+    auto range_header = request.get_header(KnownHeader::Range);
+    if (!is_get || !range_header || !if_range_allows(request, response)) {
+        return;
+    }
+    uint64_t size = response.body_size();
+    std::vector<ByteRange> ranges;
+    switch (parse_ranges(*range_header, size, ranges)) {
+        case RangeResult::IGNORE:
+            return;
+        case RangeResult::UNSATISFIABLE:
+            response.set_status(HttpStatusCode::RangeNotSatisfiable);
+            response.body_segments().clear();
+            response.remove_header(KnownHeader::ContentLength);
+            response.set_header(KnownHeader::ContentRange, std::format("bytes */{}", size));
+            return;
+        case RangeResult::SATISFIABLE:
+            send_ranges(response, ranges, size);
+            return;
+    }
+}
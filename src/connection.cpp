@@ -1,107 +1,786 @@
 #include "../include/connection.hpp"
+#include "../include/file_cache.hpp"
 #include "../include/logger.hpp"
 #include <algorithm>
 #include <cctype>
-#include <chrono>
+#include <cerrno>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <format>
 
-Connection::Connection(int client_fd, Router& router)
-    : client_fd(client_fd), router(router), state(ConnectionStatus::READING), keep_alive(false) {
-    update_last_activity();
+namespace {
+
+// Copies the request at the front of `raw` into `data`, re-pointing the views of
+// `copy` there so it outlives the read buffer.
+void copy_request(std::string_view raw, const HttpRequest& source, std::string& data, HttpRequest& copy) {
+    data.assign(raw);
+    copy = source;
+    auto rebase = [&](std::string_view view) {
+        if(view.data() < raw.data() || view.data() > raw.data() + raw.size()) {
+            return view;
+        }
+        return std::string_view(data.data() + (view.data() - raw.data()), view.size());
+    };
+    copy.full_route = rebase(copy.full_route);
+    copy.route = rebase(copy.route);
+    copy.version = rebase(copy.version);
+    copy.body = rebase(copy.body);
+    for(auto& field: copy.headers) {
+        field.name = rebase(field.name);
+        field.value = rebase(field.value);
+    }
+    for(auto& param: copy.path_params) {
+        param.second = rebase(param.second);
+    }
+    copy.query_params.assign(rebase(source.query_params.query()));
+}
+
+}
+
+Connection::Connection(Router& router, LoopMetrics& metrics, const CommonHeaders& common_headers)
+    : client_fd(-1), handle(0), router(router), metrics(metrics), common_headers(common_headers), state(ConnectionStatus::READING), keep_alive(false),
+      io_budget_exhausted(false), awaiting(false), head_routed(false), sleep_requested(false), peer_closed(false),
+      output_index(0), output_offset(0), send_message{}, counted_idle(false), parse_ns(0), parsed_at_ns(0),
+      handling(nullptr), handling_started_ns(0), handling_bytes_start(0), queued_bytes(0), write_timing_index(0) {
+    timer.context = this;
+    sleep_timer.context = this;
 }
 
 
 Connection::~Connection() {
-    if(client_fd) {
+    if(client_fd >= 0) {
+        close(client_fd);
+    }
+}
+
+void Connection::open(int fd, uint64_t slab_handle) {
+    client_fd = fd;
+    handle = slab_handle;
+    state = ConnectionStatus::READING;
+    keep_alive = false;
+    io_budget_exhausted = false;
+    awaiting = false;
+    head_routed = false;
+    sleep_requested = false;
+    peer_closed = false;
+    ring_state = RingState();
+    parse_ns = 0;
+    handling = nullptr;
+    metrics.open_connections.add(1);
+    metrics.idle_connections.add(1);
+    counted_idle = true;
+}
+
+void Connection::release() {
+    if(client_fd >= 0) {
         close(client_fd);
+        client_fd = -1;
+    }
+    parser.reset();
+    deferred.reset();
+    async.reset();
+    awaiting = false;
+    head_routed = false;
+    sleep_requested = false;
+    if(read_buffer.capacity() > RETAINED_BUFFER_SIZE) {
+        std::string().swap(read_buffer);
+    } else {
+        read_buffer.clear();
+    }
+    if(write_buffer.capacity() > RETAINED_BUFFER_SIZE) {
+        std::string().swap(write_buffer);
+    } else {
+        write_buffer.clear();
     }
+    output.clear();
+    output_index = 0;
+    output_offset = 0;
+    write_timings.clear();
+    write_timing_index = 0;
+    metrics.open_connections.sub(1);
+    if(counted_idle) {
+        metrics.idle_connections.sub(1);
+        counted_idle = false;
+    }
+}
+
+bool Connection::is_open() const {
+    return client_fd >= 0;
 }
 
-void Connection::update_last_activity() {
-    last_activity = std::chrono::steady_clock::now();
+int Connection::get_client_fd() const {
+    return client_fd;
 }
 
-bool Connection::is_timed_out(int time_seconds) const {
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - last_activity);
-    return duration.count() > time_seconds;
+uint64_t Connection::get_handle() const {
+    return handle;
 }
 
 ConnectionStatus Connection::get_state() const {
     return state;
 }
 
+ConnectionPhase Connection::get_phase() const {
+    if(state == ConnectionStatus::WRITING) {
+        return ConnectionPhase::WRITE;
+    }
+    if(state == ConnectionStatus::AWAITING) {
+        return ConnectionPhase::HANDLER;
+    }
+    if(parser.in_body()) {
+        return ConnectionPhase::BODY;
+    }
+    return read_buffer.empty() ? ConnectionPhase::IDLE : ConnectionPhase::HEADER;
+}
+
+TimerNode& Connection::get_timer() {
+    return timer;
+}
+
+TimerNode& Connection::get_sleep_timer() {
+    return sleep_timer;
+}
+
 void Connection::handle_read() {
-    update_last_activity();
-    constexpr size_t BUFFER_SIZE = 4096;
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_received = recv(client_fd, buffer, sizeof(buffer), 0);
-    if(bytes_received > 0) {
-        read_buffer.append(buffer, bytes_received);
-        if(parser.parse(read_buffer)) {
-            process_request();
-        }
-    } else if(bytes_received == 0) {
+    io_budget_exhausted = false;
+    char buffer[READ_CHUNK_SIZE];
+    size_t budget = READ_BUDGET;
+    bool eof = false;
+    while(true) {
+        if(budget == 0) {
+            io_budget_exhausted = true;
+            break;
+        }
+        ssize_t bytes_received = recv(client_fd, buffer, std::min(sizeof(buffer), budget), 0);
+        if(bytes_received > 0) {
+            read_buffer.append(buffer, bytes_received);
+            budget -= bytes_received;
+        } else if(bytes_received == 0) {
+            eof = true;
+            break;
+        } else if(errno == EINTR) {
+            continue;
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            state = ConnectionStatus::CLOSING;
+            return;
+        }
+    }
+    process_pipeline();
+    if(eof) {
+        handle_peer_closed();
+    }
+}
+
+bool Connection::handle_received(const char* data, size_t size) {
+    read_buffer.append(data, size);
+    // Input arriving while a response goes out waits here, as it would in the
+    // socket buffer with epoll, and is processed once the output has drained.
+    if(state == ConnectionStatus::READING) {
+        process_pipeline();
+        return true;
+    }
+    return read_buffer.size() < READ_BUDGET;
+}
+
+void Connection::handle_peer_closed() {
+    peer_closed = true;
+    keep_alive = false;
+    if(!has_output() && !awaiting) {
         state = ConnectionStatus::CLOSING;
+    }
+}
+
+Connection::RingState& Connection::get_ring_state() {
+    return ring_state;
+}
+
+void Connection::track_phase(ConnectionPhase phase) {
+    bool idle = phase == ConnectionPhase::IDLE;
+    if(idle == counted_idle) {
+        return;
+    }
+    if(idle) {
+        metrics.idle_connections.add(1);
     } else {
-        state = ConnectionStatus::CLOSING;
+        metrics.idle_connections.sub(1);
     }
+    counted_idle = idle;
+}
+
+void Connection::process_pipeline() {
+    // Dispatch every complete request already buffered; responses are appended to
+    // the output queue in request order and flushed together by handle_write.
+    // A deferred request holds back the ones behind it until its response is queued.
+    size_t consumed = 0;
+    while(!awaiting && parse_next(std::string_view(read_buffer).substr(consumed))) {
+        process_request(std::string_view(read_buffer).substr(consumed, parser.consumed()));
+        consumed += parser.consumed();
+        parser.reset();
+        head_routed = false;
+        if(!keep_alive) {
+            consumed = read_buffer.size();
+            break;
+        }
+    }
+    if(parser.failed()) {
+        reject_malformed(read_buffer.size() - consumed);
+        consumed = read_buffer.size();
+    }
+    if(!awaiting && !head_routed && parser.in_body()) {
+        head_routed = true;
+        route_head(std::string_view(read_buffer).substr(consumed));
+    }
+    // Keep only the unprocessed tail; the parser's offsets are relative to it.
+    read_buffer.erase(0, consumed);
+    if(has_output()) {
+        state = ConnectionStatus::WRITING;
+    } else if(awaiting) {
+        state = ConnectionStatus::AWAITING;
+    } else if(state == ConnectionStatus::AWAITING) {
+        // A handler that failed after its response was sent leaves nothing to write.
+        state = keep_alive ? ConnectionStatus::READING : ConnectionStatus::CLOSING;
+    }
+}
+
+bool Connection::parse_next(std::string_view data) {
+    if(!metrics.enabled()) {
+        return parser.parse(data);
+    }
+    // A request arriving over several reads is parsed in several calls; its parse
+    // time is their sum.
+    uint64_t started = metrics_clock_ns();
+    bool complete = parser.parse(data);
+    parsed_at_ns = metrics_clock_ns();
+    parse_ns += parsed_at_ns - started;
+    return complete;
 }
 
 void Connection::handle_write() {
-    update_last_activity();
-    ssize_t bytes_sent = send(client_fd, write_buffer.c_str(), write_buffer.size(), 0);
-
-    if (bytes_sent > 0) {
-        write_buffer.erase(0, bytes_sent);
-        if (write_buffer.empty()) {
-            if(keep_alive) {
-                parser.reset();
-                read_buffer.clear();
-                state = ConnectionStatus::READING;
-            } else {
-                state = ConnectionStatus::CLOSING;
-            }
+    io_budget_exhausted = false;
+    size_t sent = 0;
+    do {
+        write_output(sent);
+        if(state == ConnectionStatus::CLOSING || has_output()) {
+            return;
         }
+    } while(refill_output());
+}
+
+bool Connection::refill_output() {
+    output.clear();
+    write_buffer.clear();
+    output_index = 0;
+    output_offset = 0;
+    write_timings.clear();
+    write_timing_index = 0;
+    // A coroutine handler waiting for its chunk to be sent continues, and what it
+    // queues next goes out in the same pass.
+    if(resume_writer()) {
+        return true;
+    }
+    if(awaiting) {
+        state = ConnectionStatus::AWAITING;
+    } else if((keep_alive && !peer_closed) || async_running()) {
+        state = ConnectionStatus::READING;
     } else {
         state = ConnectionStatus::CLOSING;
     }
+    // With io_uring, requests may have been received while the output was going out.
+    if(state == ConnectionStatus::READING && !read_buffer.empty()) {
+        process_pipeline();
+        return has_output();
+    }
+    return false;
+}
+
+const struct msghdr* Connection::prepare_send() {
+    if(!has_output() || output[output_index].body.is_file()) {
+        return nullptr;
+    }
+    seal_output();
+    send_message = {};
+    send_message.msg_iov = send_iov;
+    send_message.msg_iovlen = gather_output(send_iov);
+    return &send_message;
+}
+
+void Connection::complete_send(int result) {
+    ring_state.send_in_flight = false;
+    if(result < 0) {
+        if(result != -EINTR && result != -EAGAIN) {
+            state = ConnectionStatus::CLOSING;
+        }
+        return;
+    }
+    advance_output(static_cast<size_t>(result));
+    if(!has_output()) {
+        refill_output();
+    }
 }
 
-void Connection::process_request() {
-    HttpRequest request = parser.get_request();
-    HttpResponse response;
+void Connection::seal_output() {
+    // The kernel reads an io_uring send after submission, so the buffered bytes
+    // move to a buffer of their own that later responses cannot reallocate.
+    if(write_buffer.empty()) {
+        return;
+    }
+    if(!sealed_buffer || sealed_buffer.use_count() > 1) {
+        sealed_buffer = std::make_shared<std::string>();
+    }
+    sealed_buffer->swap(write_buffer);
+    write_buffer.clear();
+    BodySegment sealed{std::shared_ptr<const std::string>(sealed_buffer)};
+    for(size_t i = output_index; i < output.size(); ++i) {
+        if(output[i].body.size() == 0) {
+            output[i].body = sealed.slice(output[i].offset, output[i].length);
+        }
+    }
+}
 
-    auto handler = router.match_route(request.method, request.route, request);
+void Connection::write_output(size_t& sent) {
+    while(output_index < output.size()) {
+        if(sent >= WRITE_BUDGET) {
+            io_budget_exhausted = true;
+            break;
+        }
+        ssize_t bytes_sent;
+        const OutputSegment& current = output[output_index];
+        if(current.body.is_file()) {
+            // Kernel-to-socket copy. A file truncated under us returns 0 and closes
+            // the connection, since the promised Content-Length cannot be met.
+            off_t offset = static_cast<off_t>(current.body.file_offset() + output_offset);
+            bytes_sent = sendfile(client_fd, current.body.file()->fd, &offset, current.length - output_offset);
+        } else {
+            struct iovec iov[MAX_IOVECS];
+            struct msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = gather_output(iov);
+            bytes_sent = sendmsg(client_fd, &message, MSG_NOSIGNAL);
+        }
+        if(bytes_sent > 0) {
+            sent += bytes_sent;
+            advance_output(static_cast<size_t>(bytes_sent));
+        } else if(bytes_sent < 0 && errno == EINTR) {
+            continue;
+        } else if(bytes_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            state = ConnectionStatus::CLOSING;
+            return;
+        }
+    }
+}
+
+int Connection::gather_output(struct iovec* iov) const {
+    int iov_count = 0;
+    for(size_t i = output_index; i < output.size() && iov_count < MAX_IOVECS; ++i) {
+        if(output[i].body.is_file()) {
+            break;
+        }
+        std::string_view data = output_view(output[i]);
+        if(i == output_index) {
+            data.remove_prefix(output_offset);
+        }
+        iov[iov_count].iov_base = const_cast<char*>(data.data());
+        iov[iov_count].iov_len = data.size();
+        ++iov_count;
+    }
+    return iov_count;
+}
+
+void Connection::advance_output(size_t bytes) {
+    while(bytes > 0) {
+        size_t remaining = output[output_index].length - output_offset;
+        if(bytes < remaining) {
+            output_offset += bytes;
+            break;
+        }
+        bytes -= remaining;
+        // Drop the reference now so a shared body is freed as soon as it is sent.
+        output[output_index].body = BodySegment();
+        ++output_index;
+        output_offset = 0;
+    }
+    if(write_timing_index < write_timings.size()) {
+        record_writes();
+    }
+}
+
+void Connection::record_writes() {
+    uint64_t now = 0;
+    while(write_timing_index < write_timings.size() && write_timings[write_timing_index].end <= output_index) {
+        if(now == 0) {
+            now = metrics_clock_ns();
+        }
+        const WriteTiming& timing = write_timings[write_timing_index];
+        timing.route->write.record(now - timing.queued_ns);
+        ++write_timing_index;
+    }
+}
+
+std::string_view Connection::output_view(const OutputSegment& segment) const {
+    if(segment.body.size() > 0) {
+        return segment.body.view();
+    }
+    return std::string_view(write_buffer).substr(segment.offset, segment.length);
+}
+
+bool Connection::has_output() const {
+    return output_index < output.size();
+}
+
+void Connection::queue_buffered(size_t begin) {
+    size_t length = write_buffer.size() - begin;
+    if(length == 0) {
+        return;
+    }
+    queued_bytes += length;
+    if(!output.empty()) {
+        OutputSegment& last = output.back();
+        if(last.body.size() == 0 && last.offset + last.length == begin) {
+            last.length += length;
+            return;
+        }
+    }
+    output.push_back(OutputSegment{begin, length, BodySegment()});
+}
+
+void Connection::queue_response(HttpResponse& response) {
+    size_t begin = write_buffer.size();
+    response.serialize_head(write_buffer, common_headers, keep_alive);
+    for(auto& segment: response.body_segments()) {
+        queue_body(std::move(segment), begin);
+    }
+    queue_buffered(begin);
+}
+
+void Connection::queue_cached(const CachedResponse& cached) {
+    // The stored bytes are shared with every other connection serving this entry;
+    // only the common Server, Date and Connection lines are written per response.
+    BodySegment wire(cached.wire);
+    size_t begin = write_buffer.size();
+    queue_body(wire.slice(0, cached.status_line_size), begin);
+    common_headers.append_to(write_buffer, keep_alive, !cached.own_server);
+    queue_body(wire.slice(cached.status_line_size, wire.size() - cached.status_line_size), begin);
+    queue_buffered(begin);
+}
+
+void Connection::queue_body(BodySegment segment, size_t& begin) {
+    // Heads and small bodies are gathered in write_buffer from `begin` on; large
+    // bodies and files are moved into the queue as they are, so they are sent
+    // without another copy.
+    if(!segment.is_file() && segment.size() <= INLINE_BODY_SIZE) {
+        write_buffer += segment.view();
+        return;
+    }
+    queue_buffered(begin);
+    size_t length = segment.size();
+    queued_bytes += length;
+    output.push_back(OutputSegment{0, length, std::move(segment)});
+    begin = write_buffer.size();
+}
+
+bool Connection::has_pending_io() const {
+    return io_budget_exhausted && state != ConnectionStatus::CLOSING;
+}
+
+void Connection::process_request(std::string_view raw) {
+    if (async) {
+        // The body of a request whose coroutine handler started with the head.
+        record_received(raw.size());
+        deliver_body();
+        return;
+    }
+    HttpRequest& request = parser.get_request();
+    const RouteTree::Route* route = router.match(request.method, request.route, request);
     keep_alive = should_keep_alive(request);
-    if (handler.has_value()) {
-        response = handler.value()(request);
+    begin_handling(route);
+    record_received(raw.size());
+    if (route != nullptr && route->async_handler) {
+        start_async(*route, raw, true);
+        return;
+    }
+    if (route != nullptr && route->options.blocking) {
+        defer_request(*route, raw);
+        return;
+    }
+    // The response is serialized into the output queue before the scope ends;
+    // body strings moved into it are heap-owned and go along unchanged.
+    RequestArena::Scope scope(arena);
+    RouteReply reply;
+    if (route != nullptr) {
+        reply = router.dispatch(*route, request, false);
+    } else {
+        reply.response.set_status(HttpStatusCode::NotFound);
+        reply.response.set_content_type(MimeType::TextPlain);
+        reply.response.set_body("Route not found");
+    }
+    if (reply.joined) {
+        // An identical coalesced request is running; wait for it like for a
+        // blocking handler, without holding the loop.
+        defer_request(*route, raw);
+        deferred->reply.joined = std::move(reply.joined);
+        return;
+    }
+    queue_reply(reply);
+    Logger::get_instance().info("Handled request for client {}", client_fd);
+}
+
+void Connection::reject_malformed(size_t received) {
+    // Nothing after a malformed head can be framed, so the connection closes
+    // once the 400 is out.
+    keep_alive = false;
+    begin_handling(nullptr);
+    record_received(received);
+    RouteReply reply;
+    reply.response.set_status(HttpStatusCode::BadRequest);
+    reply.response.set_content_type(MimeType::TextPlain);
+    reply.response.set_body("Bad Request");
+    queue_reply(reply);
+    parser.reset();
+    Logger::get_instance().warning("Malformed request head from client {}", client_fd);
+}
+
+void Connection::defer_request(const RouteTree::Route& route, std::string_view raw) {
+    // The request is copied so the worker never touches read_buffer, which is
+    // reused as soon as this connection times out or is released.
+    auto job = std::make_unique<DeferredRequest>();
+    copy_request(raw, parser.get_request(), job->data, job->request);
+    job->route = &route;
+    job->handle = handle;
+    deferred = std::move(job);
+    awaiting = true;
+}
+
+std::unique_ptr<DeferredRequest> Connection::take_deferred() {
+    return std::move(deferred);
+}
+
+void Connection::complete_deferred(RouteReply& reply) {
+    awaiting = false;
+    queue_reply(reply);
+    Logger::get_instance().info("Handled request for client {}", client_fd);
+    // Requests pipelined behind the deferred one have waited in read_buffer.
+    process_pipeline();
+}
+
+void Connection::route_head(std::string_view raw) {
+    // Coroutine handlers start as soon as the head is in, so they can answer or
+    // stream before a large body has arrived. Other routes wait for the body.
+    HttpRequest& request = parser.get_request();
+    const RouteTree::Route* route = router.match(request.method, request.route, request);
+    if (route != nullptr && route->async_handler) {
+        keep_alive = should_keep_alive(request);
+        begin_handling(route);
+        start_async(*route, raw, false);
+    }
+}
+
+void Connection::begin_handling(const RouteTree::Route* route) {
+    if (!metrics.enabled()) {
+        return;
+    }
+    handling = route != nullptr ? &metrics.route(route->id) : &metrics.unmatched();
+    handling_started_ns = parsed_at_ns;
+    handling_bytes_start = queued_bytes;
+}
+
+void Connection::record_received(size_t bytes) {
+    if (handling != nullptr) {
+        handling->parse.record(parse_ns);
+        handling->bytes_in.add(bytes);
+    }
+    parse_ns = 0;
+}
+
+void Connection::finish_handling(unsigned status) {
+    if (handling == nullptr) {
+        return;
+    }
+    uint64_t now = metrics_clock_ns();
+    handling->handler.record(now - handling_started_ns);
+    handling->record_status(status);
+    handling->bytes_out.add(queued_bytes - handling_bytes_start);
+    write_timings.push_back(WriteTiming{handling, now, output.size()});
+}
+
+void Connection::start_async(const RouteTree::Route& route, std::string_view raw, bool complete) {
+    auto call = std::make_unique<AsyncCall>();
+    RequestContext& context = call->context;
+    copy_request(raw, parser.get_request(), call->data, context.request_);
+    context.body_ready_ = complete;
+    if (!complete) {
+        context.request_.body = {};
+    }
+    // Chunked framing needs HTTP/1.1; older clients get the written chunks as one body.
+    call->chunked = context.request_.version == "HTTP/1.1";
+    call->task = (*route.async_handler)(context);
+    context.waiting_ = call->task.handle();
+    async = std::move(call);
+    awaiting = complete;
+    drive_async();
+}
+
+void Connection::deliver_body() {
+    // The parser has re-pointed the request at the buffer holding the whole body.
+    async->body.assign(parser.get_request().body);
+    RequestContext& context = async->context;
+    context.request_.body = async->body;
+    context.body_ready_ = true;
+    if (async->task.done()) {
+        // Answered before the body arrived; the body only had to be consumed.
+        async.reset();
+        return;
+    }
+    awaiting = true;
+    drive_async();
+}
+
+void Connection::drive_async() {
+    RequestContext& context = async->context;
+    while (true) {
+        if (async->task.done()) {
+            finish_async();
+            return;
+        }
+        if (context.wait_ == RequestContext::Wait::SLEEP ||
+            (context.wait_ == RequestContext::Wait::BODY && !context.body_ready_) ||
+            (context.wait_ == RequestContext::Wait::DRAIN && has_output())) {
+            return;
+        }
+        context.wait_ = RequestContext::Wait::NONE;
+        context.waiting_.resume();
+        if (context.wait_ == RequestContext::Wait::SLEEP) {
+            sleep_requested = true;
+        } else if (context.wait_ == RequestContext::Wait::DRAIN) {
+            BodySegment chunk(std::move(context.chunk_));
+            context.chunk_.clear();
+            if (async->chunked) {
+                if (!async->streaming) {
+                    queue_stream_head();
+                }
+                queue_chunk(std::move(chunk));
+            } else {
+                context.response_.append_body(std::move(chunk));
+            }
+            async->streaming = true;
+        }
+    }
+}
+
+void Connection::finish_async() {
+    AsyncCall& call = *async;
+    awaiting = false;
+    std::optional<HttpResponse> response;
+    try {
+        response = call.task.take_response();
+    } catch (const std::exception& e) {
+        Logger::get_instance().error("Handler for client {} failed: {}", client_fd, e.what());
+    }
+    if (call.streaming && call.chunked) {
+        if (response) {
+            for (auto& segment: response->body_segments()) {
+                queue_chunk(std::move(segment));
+            }
+            size_t begin = write_buffer.size();
+            write_buffer += "0\r\n\r\n";
+            queue_buffered(begin);
+        } else {
+            // Without the last chunk the client sees a truncated response.
+            keep_alive = false;
+        }
     } else {
-        response.set_status(HttpStatusCode::NotFound);
-        response.set_content_type(MimeType::TextPlain);
-        response.set_body("Route not found");
+        if (!response) {
+            response.emplace();
+            response->set_status(HttpStatusCode::InternalServerError);
+            response->set_content_type(MimeType::TextPlain);
+            response->set_body("Internal server error");
+        } else if (call.streaming) {
+            HttpResponse& streamed = call.context.response_;
+            for (auto& segment: response->body_segments()) {
+                streamed.append_body(std::move(segment));
+            }
+            response = std::move(streamed);
+        }
+        queue_response(*response);
+    }
+    finish_handling(call.streaming && call.chunked ? call.context.response_.get_status().get_status_as_code()
+                                                   : response->get_status().get_status_as_code());
+    Logger::get_instance().info("Handled request for client {}", client_fd);
+    if (call.context.body_ready_) {
+        async.reset();
+    }
+}
+
+bool Connection::resume_writer() {
+    if (!async_running() || async->context.wait_ != RequestContext::Wait::DRAIN || io_budget_exhausted) {
+        return false;
     }
-    if(keep_alive) {
-        response.set_header("Connection", "keep-alive");
-    }else {
-        response.set_header("Connection", "close");
+    drive_async();
+    process_pipeline();
+    return has_output();
+}
+
+bool Connection::async_running() const {
+    return async && !async->task.done();
+}
+
+void Connection::wake_sleeper() {
+    if (!async_running() || async->context.wait_ != RequestContext::Wait::SLEEP) {
+        return;
     }
-    write_buffer = response.to_string();
-    state = ConnectionStatus::WRITING;
-    Logger::get_instance().info(std::format("Handled request for client {}", client_fd));
+    async->context.wait_ = RequestContext::Wait::NONE;
+    drive_async();
+    process_pipeline();
+}
+
+std::optional<std::chrono::milliseconds> Connection::take_sleep() {
+    if (!sleep_requested) {
+        return std::nullopt;
+    }
+    sleep_requested = false;
+    return async->context.sleep_for_;
+}
+
+void Connection::queue_stream_head() {
+    HttpResponse& head = async->context.response_;
+    head.set_header(KnownHeader::TransferEncoding, "chunked");
+    size_t begin = write_buffer.size();
+    head.serialize_head(write_buffer, common_headers, keep_alive);
+    queue_buffered(begin);
+}
+
+void Connection::queue_chunk(BodySegment segment) {
+    // An empty chunk would end the body.
+    if (segment.size() == 0) {
+        return;
+    }
+    size_t begin = write_buffer.size();
+    write_buffer += std::format("{:x}\r\n", segment.size());
+    queue_body(std::move(segment), begin);
+    write_buffer += "\r\n";
+    queue_buffered(begin);
+}
+
+void Connection::queue_reply(RouteReply& reply) {
+    if (reply.shared) {
+        queue_cached(*reply.shared);
+        finish_handling(static_cast<unsigned>(reply.shared->status));
+        return;
+    }
+    queue_response(reply.response);
+    finish_handling(reply.response.get_status().get_status_as_code());
 }
 
 bool Connection::should_keep_alive(const HttpRequest& request) {
-    auto it = request.headers.find("Connection");
-    if(it != request.headers.end()) {
-        std::string conn_header = it->second;
-        std::transform(conn_header.begin(), conn_header.end(), conn_header.begin(), ::tolower);
-        if(conn_header == "close") {
+    auto connection_header = request.get_header(KnownHeader::Connection);
+    if(connection_header.has_value() && iequals(*connection_header, "close")) {
         Logger::get_instance().info("Connection header set to close");
-            return false;
-        }
+        return false;
     }
     if(request.version == "HTTP/1.1") {
         Logger::get_instance().info("Http 1.1 detected. Defaulting to keep-alive");
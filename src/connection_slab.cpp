@@ -0,0 +1,45 @@
+#include "../include/connection_slab.hpp"
+
+ConnectionSlab::ConnectionSlab(Router& router, LoopMetrics& metrics, const CommonHeaders& common_headers)
+    : router(router), metrics(metrics), common_headers(common_headers), in_use(0) {}
+
+Connection* ConnectionSlab::acquire(int client_fd) {
+    uint32_t index;
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(slots.size());
+        slots.push_back(Slot{std::make_unique<Connection>(router, metrics, common_headers), 1});
+        free_slots.reserve(slots.capacity());
+    }
+    Slot& slot = slots[index];
+    uint64_t handle = (static_cast<uint64_t>(slot.generation) << 32) | index;
+    slot.connection->open(client_fd, handle);
+    ++in_use;
+    return slot.connection.get();
+}
+
+Connection* ConnectionSlab::get(uint64_t handle) const {
+    uint32_t index = static_cast<uint32_t>(handle);
+    uint32_t generation = static_cast<uint32_t>(handle >> 32);
+    if (index >= slots.size() || slots[index].generation != generation) {
+        return nullptr;
+    }
+    Connection* connection = slots[index].connection.get();
+    return connection->is_open() ? connection : nullptr;
+}
+
+void ConnectionSlab::release(Connection* connection) {
+    uint32_t index = static_cast<uint32_t>(connection->get_handle());
+    Slot& slot = slots[index];
+    connection->release();
+    // Skip generation 0xFFFFFFFF so live handles never collide with reserved ones.
+    slot.generation = slot.generation == 0xFFFFFFFEu ? 1 : slot.generation + 1;
+    free_slots.push_back(index);
+    --in_use;
+}
+
+size_t ConnectionSlab::size() const {
+    return in_use;
+}
@@ -1,104 +1,554 @@
 #include "../include/event_loop.hpp"
 #include "../include/http_server.hpp"
 #include "../include/logger.hpp"
-#include <memory>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
 #include <format>
+#include <mutex>
 #include <stdexcept>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <vector>
 
-EventLoop::EventLoop(Router& router, int keep_alive_timeout): router(router), keep_alive_timeout(keep_alive_timeout) {
+namespace {
+
+uint64_t monotonic_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// io_uring user_data is a connection handle with the operation in bits 28-31 of
+// its slot index, which no slab grows into. The loop's own descriptors use the
+// reserved handles and no operation.
+enum class RingOp : uint64_t {
+    NONE, RECV, SEND, POLL_OUT, CANCEL
+};
+
+constexpr unsigned RING_OP_SHIFT = 28;
+constexpr uint64_t RING_OP_MASK = uint64_t(0xF) << RING_OP_SHIFT;
+
+uint64_t ring_tag(uint64_t handle, RingOp op) {
+    return handle | (static_cast<uint64_t>(op) << RING_OP_SHIFT);
+}
+
+}
+
+EventLoop::EventLoop(Router& router, const TimeoutConfig& timeouts)
+    : router(router), timeouts(timeouts), listen_fd(-1), owns_listener(false),
+      loop_time_ms(monotonic_ms()), timers(TIMER_TICK_MS, loop_time_ms), connections(router, metrics, common_headers), worker_pool(nullptr) {
     epoll_fd = epoll_create1(0);
     if(epoll_fd < 0) {
         throw std::runtime_error("Failed to create epoll file descriptor");
     }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(wake_fd < 0) {
+        close(epoll_fd);
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_HANDLE;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0) {
+        close(wake_fd);
+        close(epoll_fd);
+        throw std::runtime_error("Failed to add eventfd to epoll");
+    }
+    completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    event.data.u64 = COMPLETION_HANDLE;
+    if(completion_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, completion_fd, &event) < 0) {
+        if(completion_fd >= 0) {
+            close(completion_fd);
+        }
+        close(wake_fd);
+        close(epoll_fd);
+        throw std::runtime_error("Failed to add completion eventfd to epoll");
+    }
 }
 
 EventLoop::~EventLoop() {
+    for(int fd: handoff_fds) {
+        close(fd);
+    }
+    if(owns_listener && listen_fd >= 0) {
+        close(listen_fd);
+    }
+    close(wake_fd);
+    close(completion_fd);
     if(epoll_fd) {
         close(epoll_fd);
     }
 }
 
+void EventLoop::add_listener(int fd, bool take_ownership, bool exclusive) {
+    listen_fd = fd;
+    owns_listener = take_ownership;
+    if(ring) {
+        // A shared socket needs nothing like EPOLLEXCLUSIVE: each completed accept
+        // goes to exactly one ring.
+        ring->accept_multishot(fd, LISTENER_HANDLE);
+        return;
+    }
+    // Level-triggered: connections left over after an accept batch are reported again.
+    struct epoll_event event;
+    event.events = exclusive ? (EPOLLIN | EPOLLEXCLUSIVE) : EPOLLIN;
+    event.data.u64 = LISTENER_HANDLE;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        throw std::runtime_error(std::format("Failed to add listening socket to epoll: {}", strerror(errno)));
+    }
+}
+
+void EventLoop::set_worker_pool(WorkerPool* pool) {
+    worker_pool = pool;
+}
+
+bool EventLoop::use_io_uring() {
+    try {
+        ring = std::make_unique<IoUring>(RING_ENTRIES, RING_BUFFER_COUNT, RING_BUFFER_SIZE);
+    } catch(const std::exception& e) {
+        Logger::get_instance().warning("io_uring unavailable, using epoll: {}", e.what());
+        return false;
+    }
+    ring->poll(wake_fd, POLLIN, true, WAKE_HANDLE);
+    ring->poll(completion_fd, POLLIN, true, COMPLETION_HANDLE);
+    return true;
+}
+
+void EventLoop::complete_deferred(std::unique_ptr<DeferredRequest> job) {
+    {
+        std::lock_guard<std::mutex> lock(completed_mtx);
+        completed.push_back(std::move(job));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(completion_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+LoopMetrics& EventLoop::get_metrics() {
+    return metrics;
+}
+
+const LoopMetrics& EventLoop::get_metrics() const {
+    return metrics;
+}
+
+void EventLoop::set_timeouts(const TimeoutConfig& config) {
+    timeouts = config;
+}
+
 void EventLoop::run() {
     Logger::get_instance().info("Event loop started");
     while(HttpServer::running) {
-        handle_events(); 
-        check_timeout();
+        if(ring) {
+            handle_completions();
+        } else {
+            handle_events();
+        }
+        expire_timers();
     }
 }
 
+void EventLoop::wake() {
+    // Only async-signal-safe calls here; HttpServer::stop runs from the SIGINT handler.
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
 void EventLoop::add_connection(int client_fd) {
     int flags = fcntl(client_fd, F_GETFL, 0);
     fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-    connections[client_fd] = std::make_unique<Connection>(client_fd, router);
+    {
+        std::lock_guard<std::mutex> lock(handoff_mtx);
+        handoff_fds.push_back(client_fd);
+    }
+    wake();
+}
+
+void EventLoop::register_handoffs() {
+    uint64_t count;
+    while(read(wake_fd, &count, sizeof(count)) > 0) {}
+    {
+        std::lock_guard<std::mutex> lock(handoff_mtx);
+        registering_fds.swap(handoff_fds);
+    }
+    for(int fd: registering_fds) {
+        register_connection(fd);
+    }
+    registering_fds.clear();
+}
+
+void EventLoop::accept_connections() {
+    for(int i = 0; i < ACCEPT_BATCH; ++i) {
+        int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(client_fd < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            // EAGAIN: drained, or another loop sharing the socket took the connection.
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+                Logger::get_instance().error("Accept failed: {}", strerror(errno));
+            }
+            return;
+        }
+        register_connection(client_fd);
+    }
+}
+
+void EventLoop::register_connection(int client_fd) {
+    Connection* conn = connections.acquire(client_fd);
+    if(ring) {
+        start_ring_io(conn);
+        timers.arm(conn->get_timer(), loop_time_ms + deadline_for(ConnectionPhase::IDLE).count());
+        return;
+    }
     struct epoll_event event;
     event.events = EPOLLIN | EPOLLET;
-    event.data.fd = client_fd;
+    event.data.u64 = conn->get_handle();
     if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
         Logger::get_instance().error("Failed to add client fd to epoll");
-        connections.erase(client_fd);
+        connections.release(conn);
     } else {
-        Logger::get_instance().info(std::format("New connection accepted on fd: {}", client_fd));
+        Logger::get_instance().debug("New connection accepted on fd: {}", client_fd);
+        timers.arm(conn->get_timer(), loop_time_ms + deadline_for(ConnectionPhase::IDLE).count());
+    }
+}
+
+std::chrono::milliseconds EventLoop::deadline_for(ConnectionPhase phase) const {
+    switch(phase) {
+        case ConnectionPhase::IDLE:
+            return timeouts.keep_alive;
+        case ConnectionPhase::HEADER:
+            return timeouts.header;
+        case ConnectionPhase::BODY:
+            return timeouts.body;
+        case ConnectionPhase::HANDLER:
+            return timeouts.handler;
+        case ConnectionPhase::WRITE:
+            return timeouts.write;
+    }
+    return timeouts.keep_alive;
+}
+
+void EventLoop::close_connection(Connection* conn) {
+    // Closing the fd removes it from the epoll set; events for it already returned by
+    // epoll_wait carry the old handle and are dropped by the slab's generation check.
+    timers.cancel(conn->get_timer());
+    timers.cancel(conn->get_sleep_timer());
+    if(ring) {
+        // The ring holds its own reference to the socket, so closing the fd would
+        // not end the multishot receive; shutting it down completes everything.
+        shutdown(conn->get_client_fd(), SHUT_RDWR);
+        Connection::RingState& ring_state = conn->get_ring_state();
+        if(ring_state.send_in_flight) {
+            // The send still points into this connection's output.
+            ring_state.closing = true;
+            return;
+        }
     }
+    connections.release(conn);
 }
 
 void EventLoop::handle_events() {
     constexpr int MAX_EVENTS = 128;
     struct epoll_event events[MAX_EVENTS];
-    int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+    // Connections that stopped on their I/O budget will not get another edge, so poll
+    // without blocking and serve them again after this round of events. Otherwise
+    // sleep until the earliest connection deadline.
+    int timeout = pending.empty() ? timers.next_timeout_ms(monotonic_ms()) : 0;
+    int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+    loop_time_ms = monotonic_ms();
+    common_headers.refresh(std::time(nullptr));
     if(num_events < 0) {
         if(HttpServer::running) {
             Logger::get_instance().error("epoll wait error");
         }
         return;
     }
+    carried_over.swap(pending);
     for(int i = 0; i < num_events; ++i) {
-        int fd = events[i].data.fd;
-        auto it = connections.find(fd);
-        if(it == connections.end()) {
-            continue;
+        uint64_t handle = events[i].data.u64;
+        if(handle == WAKE_HANDLE) {
+            register_handoffs();
+        } else if(handle == LISTENER_HANDLE) {
+            accept_connections();
+        } else if(handle == COMPLETION_HANDLE) {
+            finish_deferred();
+        } else if(Connection* conn = connections.get(handle)) {
+            serve_connection(conn, events[i].events);
         }
-        Connection* conn = it->second.get();
-        if(events[i].events & (EPOLLERR | EPOLLHUP)) {
-            Logger::get_instance().info(std::format("Closing connection for client {} due to error", fd));
-            connections.erase(it);
+    }
+    for(uint64_t handle: carried_over) {
+        Connection* conn = connections.get(handle);
+        if(conn == nullptr) {
             continue;
         }
-        if(events[i].events & EPOLLIN) {
-            conn->handle_read();
+        uint32_t ready = conn->get_state() == ConnectionStatus::WRITING ? EPOLLOUT : EPOLLIN;
+        serve_connection(conn, ready);
+    }
+    carried_over.clear();
+}
+
+void EventLoop::handle_completions() {
+    // Sends queued while handling the last round go to the kernel in the same call
+    // that waits for the next one.
+    ring->submit_and_wait(timers.next_timeout_ms(monotonic_ms()));
+    loop_time_ms = monotonic_ms();
+    common_headers.refresh(std::time(nullptr));
+    ring->for_each_completion([this](const struct io_uring_cqe& cqe) {
+        complete_ring_op(cqe);
+    });
+}
+
+void EventLoop::complete_ring_op(const struct io_uring_cqe& cqe) {
+    RingOp op = static_cast<RingOp>((cqe.user_data & RING_OP_MASK) >> RING_OP_SHIFT);
+    uint64_t handle = cqe.user_data & ~RING_OP_MASK;
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+    if(op == RingOp::NONE) {
+        // Multishot requests end on errors and overflow and are simply re-armed.
+        if(handle == WAKE_HANDLE) {
+            register_handoffs();
+            if(!more) {
+                ring->poll(wake_fd, POLLIN, true, WAKE_HANDLE);
+            }
+        } else if(handle == COMPLETION_HANDLE) {
+            finish_deferred();
+            if(!more) {
+                ring->poll(completion_fd, POLLIN, true, COMPLETION_HANDLE);
+            }
+        } else if(handle == LISTENER_HANDLE) {
+            if(cqe.res >= 0) {
+                register_connection(cqe.res);
+            } else if(cqe.res != -EAGAIN && cqe.res != -ECONNABORTED && HttpServer::running) {
+                Logger::get_instance().error("Accept failed: {}", strerror(-cqe.res));
+            }
+            if(!more && HttpServer::running) {
+                ring->accept_multishot(listen_fd, LISTENER_HANDLE);
+            }
         }
-        if(events[i].events & EPOLLOUT) {
+        return;
+    }
+    if(op == RingOp::CANCEL) {
+        return;
+    }
+    Connection* conn = connections.get(handle);
+    if(op == RingOp::RECV) {
+        complete_recv(conn, cqe);
+        return;
+    }
+    if(conn == nullptr) {
+        return;
+    }
+    Connection::RingState& ring_state = conn->get_ring_state();
+    ring_state.send_in_flight = false;
+    if(ring_state.closing) {
+        connections.release(conn);
+        return;
+    }
+    ConnectionStatus before = conn->get_state();
+    ConnectionPhase phase_before = conn->get_phase();
+    if(op == RingOp::SEND) {
+        conn->complete_send(cqe.res);
+    }
+    // POLL_OUT: the socket has room again; start_ring_io sends the next segment.
+    settle_connection(conn, before, phase_before);
+}
+
+void EventLoop::complete_recv(Connection* conn, const struct io_uring_cqe& cqe) {
+    bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+    uint16_t buffer_id = IoUring::buffer_id(cqe.flags);
+    if(conn == nullptr || conn->get_ring_state().closing) {
+        if(has_buffer) {
+            ring->recycle(buffer_id);
+        }
+        return;
+    }
+    Connection::RingState& ring_state = conn->get_ring_state();
+    if(!(cqe.flags & IORING_CQE_F_MORE)) {
+        ring_state.recv_armed = false;
+        ring_state.recv_cancelled = false;
+    }
+    ConnectionStatus before = conn->get_state();
+    ConnectionPhase phase_before = conn->get_phase();
+    if(cqe.res > 0) {
+        bool wants_more = conn->handle_received(ring->buffer(buffer_id), static_cast<size_t>(cqe.res));
+        if(!wants_more && ring_state.recv_armed && !ring_state.recv_cancelled) {
+            // Stop reading ahead of a connection that is busy writing; the receive
+            // is armed again once it reads.
+            ring->cancel(ring_tag(conn->get_handle(), RingOp::RECV), ring_tag(conn->get_handle(), RingOp::CANCEL));
+            ring_state.recv_cancelled = true;
+        }
+    } else if(cqe.res == 0) {
+        ring_state.eof = true;
+        conn->handle_peer_closed();
+    } else if(cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+        if(has_buffer) {
+            ring->recycle(buffer_id);
+        }
+        close_connection(conn);
+        return;
+    }
+    if(has_buffer) {
+        ring->recycle(buffer_id);
+    }
+    settle_connection(conn, before, phase_before);
+}
+
+void EventLoop::start_ring_io(Connection* conn) {
+    Connection::RingState& ring_state = conn->get_ring_state();
+    int fd = conn->get_client_fd();
+    uint64_t handle = conn->get_handle();
+    if(conn->get_state() == ConnectionStatus::WRITING && !ring_state.send_in_flight) {
+        if(const struct msghdr* message = conn->prepare_send()) {
+            ring->sendmsg(fd, message, ring_tag(handle, RingOp::SEND));
+            ring_state.send_in_flight = true;
+        } else {
+            // A file segment goes out with sendfile; wait for room if it fills the socket.
             conn->handle_write();
+            if(conn->get_state() == ConnectionStatus::WRITING) {
+                ring->poll(fd, POLLOUT, false, ring_tag(handle, RingOp::POLL_OUT));
+                ring_state.send_in_flight = true;
+            }
         }
-        if(conn->get_state() == ConnectionStatus::WRITING) {
-            struct epoll_event event;
-            event.events = EPOLLOUT | EPOLLET;
-            event.data.fd = fd;
-            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
-        }else if(conn->get_state() == ConnectionStatus::READING) {
-            struct epoll_event event;
-            event.events = EPOLLIN | EPOLLET;
-            event.data.fd = fd;
-            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
-        }else if(conn->get_state() == ConnectionStatus::CLOSING) {
-            Logger::get_instance().info(std::format("Closing connection for client: {}", fd));
-            connections.erase(it);
+    }
+    if(conn->get_state() == ConnectionStatus::READING && !ring_state.recv_armed && !ring_state.eof) {
+        ring->recv_multishot(fd, ring_tag(handle, RingOp::RECV));
+        ring_state.recv_armed = true;
+    }
+}
+
+void EventLoop::serve_connection(Connection* conn, uint32_t ready_events) {
+    int fd = conn->get_client_fd();
+    if(ready_events & (EPOLLERR | EPOLLHUP)) {
+        Logger::get_instance().debug("Closing connection for client {} due to error", fd);
+        close_connection(conn);
+        return;
+    }
+    ConnectionStatus before = conn->get_state();
+    ConnectionPhase phase_before = conn->get_phase();
+    if((ready_events & EPOLLIN) && conn->get_state() == ConnectionStatus::READING) {
+        conn->handle_read();
+    }
+    // Write as soon as a response is ready instead of waiting a round trip for EPOLLOUT.
+    if(((ready_events & EPOLLOUT) || before == ConnectionStatus::READING) && conn->get_state() == ConnectionStatus::WRITING) {
+        conn->handle_write();
+    }
+    settle_connection(conn, before, phase_before);
+}
+
+void EventLoop::settle_connection(Connection* conn, ConnectionStatus before, ConnectionPhase phase_before) {
+    if(ring) {
+        start_ring_io(conn);
+    }
+    int fd = conn->get_client_fd();
+    ConnectionStatus after = conn->get_state();
+    if(after == ConnectionStatus::CLOSING) {
+        Logger::get_instance().debug("Closing connection for client: {}", fd);
+        close_connection(conn);
+        return;
+    }
+    submit_deferred(conn);
+    if(auto sleep = conn->take_sleep()) {
+        timers.arm(conn->get_sleep_timer(), loop_time_ms + sleep->count());
+    }
+    // The head deadline runs from the first byte of a request; body, write and idle
+    // deadlines are pushed back whenever the connection makes progress.
+    ConnectionPhase phase_after = conn->get_phase();
+    conn->track_phase(phase_after);
+    if(phase_after != phase_before || phase_after != ConnectionPhase::HEADER) {
+        timers.arm(conn->get_timer(), loop_time_ms + deadline_for(phase_after).count());
+    }
+    if(after != before && !ring) {
+        // No interest while awaiting a handler: reads resume once the reply is sent,
+        // and re-arming EPOLLIN then reports data that arrived in the meantime.
+        struct epoll_event event;
+        event.events = EPOLLET;
+        if(after == ConnectionStatus::WRITING) {
+            event.events |= EPOLLOUT;
+        } else if(after == ConnectionStatus::READING) {
+            event.events |= EPOLLIN;
         }
+        event.data.u64 = conn->get_handle();
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+    if(!ring && conn->has_pending_io()) {
+        pending.push_back(conn->get_handle());
     }
 }
 
-void EventLoop::check_timeout() {
-    std::vector<int> timed_out_fds;
-    for(const auto&[client_fd, connection]: connections) {
-        if(connection->get_state() == ConnectionStatus::READING && connection->is_timed_out(keep_alive_timeout)) {
-            timed_out_fds.push_back(client_fd);
+void EventLoop::submit_deferred(Connection* conn) {
+    std::unique_ptr<DeferredRequest> job = conn->take_deferred();
+    if(!job) {
+        return;
+    }
+    job->loop = this;
+    if(!job->reply.joined) {
+        if(worker_pool != nullptr) {
+            worker_pool->submit(std::move(job));
+            return;
         }
+        job->reply = router.dispatch(*job->route, job->request, false);
+    }
+    if(job->reply.joined) {
+        // The coalesced call it joined posts it back when done, from whichever
+        // thread ran the leader; finish_deferred then builds the reply.
+        std::shared_ptr<RequestCoalescer::Flight> flight = job->reply.joined;
+        DeferredRequest* parked = job.release();
+        flight->subscribe([parked]() {
+            parked->loop->complete_deferred(std::unique_ptr<DeferredRequest>(parked));
+        });
+        return;
     }
-    for(int cfd: timed_out_fds) {
-        Logger::get_instance().info(std::format("Connection timed out for client {}", cfd));
-        connections.erase(cfd);
+    complete_deferred(std::move(job));
+}
+
+void EventLoop::finish_deferred() {
+    uint64_t count;
+    while(read(completion_fd, &count, sizeof(count)) > 0) {}
+    {
+        std::lock_guard<std::mutex> lock(completed_mtx);
+        finishing.swap(completed);
     }
+    for(auto& job: finishing) {
+        // A connection that timed out or closed meanwhile no longer resolves.
+        Connection* conn = connections.get(job->handle);
+        if(conn == nullptr || conn->get_ring_state().closing) {
+            continue;
+        }
+        if(job->reply.joined) {
+            router.finish_joined(*job->route, job->request, job->reply);
+        }
+        ConnectionStatus before = conn->get_state();
+        ConnectionPhase phase_before = conn->get_phase();
+        conn->complete_deferred(job->reply);
+        // With io_uring the reply is sent by start_ring_io, behind any send in flight.
+        if(!ring && conn->get_state() == ConnectionStatus::WRITING) {
+            conn->handle_write();
+        }
+        settle_connection(conn, before, phase_before);
+    }
+    finishing.clear();
+}
+
+void EventLoop::expire_timers() {
+    timers.advance(loop_time_ms, [this](TimerNode& node) {
+        auto* conn = static_cast<Connection*>(node.context);
+        if(&node == &conn->get_sleep_timer()) {
+            ConnectionStatus before = conn->get_state();
+            ConnectionPhase phase_before = conn->get_phase();
+            conn->wake_sleeper();
+            if(!ring && conn->get_state() == ConnectionStatus::WRITING) {
+                conn->handle_write();
+            }
+            settle_connection(conn, before, phase_before);
+            return;
+        }
+        Logger::get_instance().debug("Connection timed out for client {}", conn->get_client_fd());
+        close_connection(conn);
+    });
 }
@@ -0,0 +1,87 @@
+#include "../include/file_cache.hpp"
+#include "../include/http_date.hpp"
+#include <fcntl.h>
+#include <format>
+#include <unistd.h>
+
+OpenFile::OpenFile(int fd, const struct stat& info)
+    : fd(fd), size(static_cast<uint64_t>(info.st_size)), modified(info.st_mtim.tv_sec),
+      device(info.st_dev), inode(info.st_ino),
+      modified_ns(static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec) {
+    etag = std::format("\"{:x}-{:x}\"", modified_ns, size);
+    last_modified = format_http_date(modified);
+}
+
+OpenFile::~OpenFile() {
+    close(fd);
+}
+
+bool OpenFile::matches(const struct stat& info) const {
+    return info.st_dev == device && info.st_ino == inode &&
+           static_cast<uint64_t>(info.st_size) == size &&
+           static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec == modified_ns;
+}
+
+FileCache::FileCache(std::chrono::milliseconds ttl, size_t max_entries)
+    : ttl(ttl), max_entries(max_entries) {}
+
+std::shared_ptr<const OpenFile> FileCache::open(const std::string& path) {
+    auto now = std::chrono::steady_clock::now();
+    std::shared_ptr<const OpenFile> cached;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = entries.find(path);
+        if (it != entries.end()) {
+            if (now - it->second.checked < ttl) {
+                return it->second.file;
+            }
+            cached = it->second.file;
+        }
+    }
+
+    // Revalidate or open outside the lock so a slow disk does not stall other loops.
+    struct stat info;
+    if (cached && stat(path.c_str(), &info) == 0 && cached->matches(info)) {
+        std::lock_guard<std::mutex> lock(mtx);
+        entries[path] = Entry{cached, now};
+        return cached;
+    }
+    std::shared_ptr<const OpenFile> file;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            file = std::make_shared<const OpenFile>(fd, info);
+        } else {
+            close(fd);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!file) {
+        entries.erase(path);
+        return nullptr;
+    }
+    auto it = entries.find(path);
+    if (it == entries.end() && entries.size() >= max_entries) {
+        evict_oldest();
+    }
+    entries[path] = Entry{file, now};
+    return file;
+}
+
+void FileCache::clear() {
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.clear();
+}
+
+void FileCache::evict_oldest() {
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->second.checked < oldest->second.checked) {
+            oldest = it;
+        }
+    }
+    if (oldest != entries.end()) {
+        entries.erase(oldest);
+    }
+}
@@ -0,0 +1,326 @@
+#include "../include/head_scanner.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 64;
+// Blocks masked per kernel call: enough to amortize the indirect call, few enough
+// that little is wasted past the end of a short head followed by pipelined data.
+constexpr size_t CHUNK_BLOCKS = 4;
+
+// One bit per byte of a 64-byte block. `invalid` flags control characters except
+// tab, LF and a CR followed by LF; kernels read one byte past the block for that.
+struct BlockMasks {
+    uint64_t lf;
+    uint64_t colon;
+    uint64_t invalid;
+};
+
+// Masks `blocks` blocks; data[blocks * BLOCK_SIZE] must be readable.
+using MaskFn = void (*)(const char* data, size_t blocks, BlockMasks* masks);
+
+constexpr uint64_t ONES = 0x0101010101010101;
+constexpr uint64_t HIGHS = 0x8080808080808080;
+
+// Nonzero if any byte of `word` is below `n` (n <= 128), or equals `value`.
+uint64_t has_less(uint64_t word, uint8_t n) {
+    return (word - ONES * n) & ~word & HIGHS;
+}
+
+uint64_t has_byte(uint64_t word, uint8_t value) {
+    return has_less(word ^ (ONES * value), 1);
+}
+
+// Without vectors, words of 8 bytes with nothing to flag are skipped whole.
+void mask_scalar(const char* data, size_t blocks, BlockMasks* masks) {
+    for (size_t b = 0; b < blocks; ++b) {
+        const char* block = data + b * BLOCK_SIZE;
+        BlockMasks mask{0, 0, 0};
+        for (size_t w = 0; w < BLOCK_SIZE; w += 8) {
+            uint64_t word;
+            std::memcpy(&word, block + w, sizeof(word));
+            if ((has_less(word, 0x20) | has_byte(word, ':') | has_byte(word, 0x7f)) == 0) {
+                continue;
+            }
+            for (size_t i = w; i < w + 8; ++i) {
+                unsigned char c = static_cast<unsigned char>(block[i]);
+                if (c == '\n') {
+                    mask.lf |= uint64_t(1) << i;
+                } else if (c == ':') {
+                    mask.colon |= uint64_t(1) << i;
+                } else if ((c < 0x20 && c != '\t' && (c != '\r' || block[i + 1] != '\n')) || c == 0x7f) {
+                    mask.invalid |= uint64_t(1) << i;
+                }
+            }
+        }
+        masks[b] = mask;
+    }
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64, so this kernel needs no CPU check.
+inline void mask_sse2_quarter(const char* p, uint64_t& lf_bits, uint64_t& colon_bits, __m128i& invalid) {
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i ctl_max = _mm_set1_epi8(0x1f);
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    __m128i is_lf = _mm_cmpeq_epi8(bytes, lf);
+    __m128i allowed = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')), is_lf),
+                                   _mm_and_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(next, lf)));
+    // Unsigned bytes <= 0x1f are the ones max(byte, 0x1f) leaves at 0x1f.
+    __m128i ctl = _mm_cmpeq_epi8(_mm_max_epu8(bytes, ctl_max), ctl_max);
+    invalid = _mm_or_si128(_mm_andnot_si128(allowed, ctl), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(0x7f)));
+    lf_bits = static_cast<uint32_t>(_mm_movemask_epi8(is_lf));
+    colon_bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(':'))));
+}
+
+void mask_sse2(const char* data, size_t blocks, BlockMasks* masks) {
+    for (size_t b = 0; b < blocks; ++b) {
+        const char* block = data + b * BLOCK_SIZE;
+        uint64_t lf[4], colon[4];
+        __m128i invalid[4];
+        mask_sse2_quarter(block, lf[0], colon[0], invalid[0]);
+        mask_sse2_quarter(block + 16, lf[1], colon[1], invalid[1]);
+        mask_sse2_quarter(block + 32, lf[2], colon[2], invalid[2]);
+        mask_sse2_quarter(block + 48, lf[3], colon[3], invalid[3]);
+        BlockMasks mask{lf[0] | (lf[1] << 16) | (lf[2] << 32) | (lf[3] << 48),
+                        colon[0] | (colon[1] << 16) | (colon[2] << 32) | (colon[3] << 48), 0};
+        __m128i any_invalid = _mm_or_si128(_mm_or_si128(invalid[0], invalid[1]), _mm_or_si128(invalid[2], invalid[3]));
+        if (_mm_movemask_epi8(any_invalid) != 0) {
+            for (int q = 0; q < 4; ++q) {
+                mask.invalid |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(invalid[q]))) << (q * 16);
+            }
+        }
+        masks[b] = mask;
+    }
+}
+
+// Lambdas do not inherit a target attribute, so the AVX2 halves are a function.
+[[gnu::target("avx2"), gnu::always_inline]]
+inline void mask_avx2_half(const char* p, uint32_t& lf_bits, uint32_t& colon_bits, __m256i& invalid) {
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i ctl_max = _mm256_set1_epi8(0x1f);
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    __m256i is_lf = _mm256_cmpeq_epi8(bytes, lf);
+    __m256i allowed = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')), is_lf),
+                                      _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(next, lf)));
+    __m256i ctl = _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, ctl_max), ctl_max);
+    invalid = _mm256_or_si256(_mm256_andnot_si256(allowed, ctl), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(0x7f)));
+    lf_bits = static_cast<uint32_t>(_mm256_movemask_epi8(is_lf));
+    colon_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(':'))));
+}
+
+[[gnu::target("avx2")]]
+void mask_avx2(const char* data, size_t blocks, BlockMasks* masks) {
+    for (size_t b = 0; b < blocks; ++b) {
+        const char* block = data + b * BLOCK_SIZE;
+        uint32_t lf_low, lf_high, colon_low, colon_high;
+        __m256i invalid_low, invalid_high;
+        mask_avx2_half(block, lf_low, colon_low, invalid_low);
+        mask_avx2_half(block + 32, lf_high, colon_high, invalid_high);
+        BlockMasks mask{lf_low | (uint64_t(lf_high) << 32), colon_low | (uint64_t(colon_high) << 32), 0};
+        __m256i any_invalid = _mm256_or_si256(invalid_low, invalid_high);
+        if (!_mm256_testz_si256(any_invalid, any_invalid)) {
+            mask.invalid = static_cast<uint32_t>(_mm256_movemask_epi8(invalid_low)) |
+                           (uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(invalid_high))) << 32);
+        }
+        masks[b] = mask;
+    }
+}
+
+#endif
+
+MaskFn kernel_function(ScanKernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__)
+        case ScanKernel::AVX2: return mask_avx2;
+        case ScanKernel::SSE2: return mask_sse2;
+#endif
+        default: return mask_scalar;
+    }
+}
+
+ScanKernel best_kernel() {
+    if (HeadScanner::kernel_supported(ScanKernel::AVX2)) {
+        return ScanKernel::AVX2;
+    }
+    if (HeadScanner::kernel_supported(ScanKernel::SSE2)) {
+        return ScanKernel::SSE2;
+    }
+    return ScanKernel::SCALAR;
+}
+
+ScanKernel& current_kernel() {
+    static ScanKernel kernel = best_kernel();
+    return kernel;
+}
+
+MaskFn& current_mask() {
+    static MaskFn mask = kernel_function(current_kernel());
+    return mask;
+}
+
+}
+
+HeadScanner::HeadScanner() {
+    reset();
+}
+
+void HeadScanner::reset() {
+    lines_.clear();
+    pos_ = 0;
+    line_start_ = 0;
+    colon_ = NO_COLON;
+    head_size_ = 0;
+    done_ = false;
+    invalid_ = false;
+}
+
+bool HeadScanner::scan(std::string_view data) {
+    if (done_ || invalid_) {
+        return true;
+    }
+    MaskFn mask_blocks = current_mask();
+    BlockMasks masks[CHUNK_BLOCKS];
+    while (pos_ < data.size()) {
+        size_t remaining = data.size() - pos_;
+        // Kernels read one byte past their last block.
+        size_t blocks = std::min((remaining - 1) / BLOCK_SIZE, CHUNK_BLOCKS);
+        size_t covered = blocks * BLOCK_SIZE;
+        if (blocks == 0) {
+            // The tail is masked from a padded copy so kernels never read past the data.
+            char tail[BLOCK_SIZE + 1];
+            std::memset(tail, 'x', sizeof(tail));
+            std::memcpy(tail, data.data() + pos_, remaining);
+            mask_blocks(tail, 1, masks);
+            blocks = 1;
+            covered = remaining;
+        } else {
+            mask_blocks(data.data() + pos_, blocks, masks);
+        }
+        for (size_t b = 0; b < blocks; ++b) {
+            Step step = scan_block(data, pos_ + b * BLOCK_SIZE, masks[b].lf | masks[b].invalid, masks[b].colon);
+            if (step == Step::DONE) {
+                return true;
+            }
+            if (step == Step::NEED_MORE) {
+                return false;
+            }
+        }
+        pos_ += covered;
+    }
+    return false;
+}
+
+HeadScanner::Step HeadScanner::scan_block(std::string_view data, size_t base, uint64_t events, uint64_t colons) {
+    // Kept in locals: the pushes to lines_ would otherwise force reloads.
+    size_t line_start = line_start_;
+    size_t colon = colon_;
+    // Records the line's first colon among this block's bits below `limit`.
+    auto take_colon = [&](unsigned limit) {
+        if (colon != NO_COLON) {
+            return;
+        }
+        uint64_t candidates = colons;
+        if (limit < 64) {
+            candidates &= (uint64_t(1) << limit) - 1;
+        }
+        if (line_start > base) {
+            candidates = line_start - base >= 64 ? 0 : candidates & (~uint64_t(0) << (line_start - base));
+        }
+        if (candidates != 0) {
+            colon = base + static_cast<size_t>(std::countr_zero(candidates));
+        }
+    };
+    Step step = Step::CONTINUE;
+    for (; events != 0; events &= events - 1) {
+        unsigned bit = static_cast<unsigned>(std::countr_zero(events));
+        size_t at = base + bit;
+        if (data[at] != '\n') {
+            // A CR ending the data may still be followed by LF.
+            if (data[at] == '\r' && at + 1 == data.size()) {
+                take_colon(bit);
+                pos_ = at;
+                step = Step::NEED_MORE;
+            } else {
+                invalid_ = true;
+                step = Step::DONE;
+            }
+            break;
+        }
+        size_t end = at > line_start && data[at - 1] == '\r' ? at - 1 : at;
+        if (end == line_start) {
+            if (!lines_.empty()) {
+                head_size_ = at + 1;
+                done_ = true;
+                step = Step::DONE;
+                break;
+            }
+            // Empty lines before the request line are ignored (RFC 9112 2.2).
+            line_start = at + 1;
+            continue;
+        }
+        take_colon(bit);
+        lines_.push_back(HeadLine{line_start, end, colon});
+        line_start = at + 1;
+        colon = NO_COLON;
+    }
+    if (step == Step::CONTINUE) {
+        take_colon(64);
+    }
+    line_start_ = line_start;
+    colon_ = colon;
+    return step;
+}
+
+const std::vector<HeadLine>& HeadScanner::lines() const {
+    return lines_;
+}
+
+size_t HeadScanner::head_size() const {
+    return head_size_;
+}
+
+bool HeadScanner::invalid() const {
+    return invalid_;
+}
+
+ScanKernel HeadScanner::active_kernel() {
+    return current_kernel();
+}
+
+bool HeadScanner::select_kernel(ScanKernel kernel) {
+    if (!kernel_supported(kernel)) {
+        return false;
+    }
+    current_kernel() = kernel;
+    current_mask() = kernel_function(kernel);
+    return true;
+}
+
+bool HeadScanner::kernel_supported(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::SCALAR: return true;
+#if defined(__x86_64__)
+        case ScanKernel::SSE2: return true;
+        case ScanKernel::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+const char* HeadScanner::kernel_name(ScanKernel kernel) {
+    switch (kernel) {
+        case ScanKernel::SSE2: return "sse2";
+        case ScanKernel::AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
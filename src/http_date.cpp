@@ -0,0 +1,49 @@
+#include "../include/http_date.hpp"
+#include <charconv>
+#include <format>
+
+namespace {
+
+constexpr const char* DAY_NAMES[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr const char* MONTH_NAMES[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                       "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+bool parse_number(std::string_view text, int& value) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+}
+
+std::string format_http_date(time_t time) {
+    // Names are spelled out by hand; strftime would follow the process locale.
+    struct tm parts;
+    gmtime_r(&time, &parts);
+    return std::format("{}, {:02} {} {:04} {:02}:{:02}:{:02} GMT",
+                       DAY_NAMES[parts.tm_wday], parts.tm_mday, MONTH_NAMES[parts.tm_mon],
+                       parts.tm_year + 1900, parts.tm_hour, parts.tm_min, parts.tm_sec);
+}
+
+std::optional<time_t> parse_http_date(std::string_view text) {
+    // "Sun, 06 Nov 1994 08:49:37 GMT": every field sits at a fixed offset.
+    if (text.size() != 29 || text.substr(3, 2) != ", " || text.substr(25) != " GMT" ||
+        text[7] != ' ' || text[11] != ' ' || text[16] != ' ' || text[19] != ':' || text[22] != ':') {
+        return std::nullopt;
+    }
+    struct tm parts{};
+    parts.tm_mon = -1;
+    for (int month = 0; month < 12; ++month) {
+        if (text.substr(8, 3) == MONTH_NAMES[month]) {
+            parts.tm_mon = month;
+            break;
+        }
+    }
+    int year = 0;
+    if (parts.tm_mon < 0 || !parse_number(text.substr(5, 2), parts.tm_mday) ||
+        !parse_number(text.substr(12, 4), year) || !parse_number(text.substr(17, 2), parts.tm_hour) ||
+        !parse_number(text.substr(20, 2), parts.tm_min) || !parse_number(text.substr(23, 2), parts.tm_sec)) {
+        return std::nullopt;
+    }
+    parts.tm_year = year - 1900;
+    return timegm(&parts);
+}
@@ -0,0 +1,150 @@
+#include "../include/http_headers.hpp"
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr std::array<std::string_view, KNOWN_HEADER_COUNT> KNOWN_NAMES = {
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Ranges",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Host",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Last-Modified",
+    "Location",
+    "Range",
+    "Server",
+    "Set-Cookie",
+    "Transfer-Encoding",
+    "User-Agent",
+    "Vary",
+};
+
+constexpr size_t MIN_KNOWN_LENGTH = 4;
+constexpr size_t MAX_KNOWN_LENGTH = 17;
+constexpr size_t HASH_SLOTS = 64;
+constexpr uint8_t NO_HEADER = UINT8_MAX;
+
+// A name's length and first and last letters, which tell the known headers apart,
+// pick its only candidate. The constants were searched for to leave no collisions.
+constexpr size_t name_hash(std::string_view name) {
+    size_t first = static_cast<unsigned char>(name.front()) | 0x20;
+    size_t last = static_cast<unsigned char>(name.back()) | 0x20;
+    return (name.size() + first + last * 6) % HASH_SLOTS;
+}
+
+constexpr std::array<uint8_t, HASH_SLOTS> make_hash_table() {
+    std::array<uint8_t, HASH_SLOTS> table{};
+    table.fill(NO_HEADER);
+    for (size_t i = 0; i < KNOWN_HEADER_COUNT; ++i) {
+        table[name_hash(KNOWN_NAMES[i])] = static_cast<uint8_t>(i);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, HASH_SLOTS> HASH_TABLE = make_hash_table();
+
+constexpr bool hash_is_perfect() {
+    for (size_t i = 0; i < KNOWN_HEADER_COUNT; ++i) {
+        if (HASH_TABLE[name_hash(KNOWN_NAMES[i])] != i || KNOWN_NAMES[i].size() < MIN_KNOWN_LENGTH ||
+            KNOWN_NAMES[i].size() > MAX_KNOWN_LENGTH) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(hash_is_perfect(), "known header names collide in HASH_TABLE");
+
+// A known name padded for word loads, with a mask that clears the case bit of
+// its letters: `c` matches `name[i]` if ((c ^ name[i]) & fold[i]) == 0.
+struct FoldedName {
+    std::array<char, MAX_KNOWN_LENGTH> name{};
+    std::array<unsigned char, MAX_KNOWN_LENGTH> fold{};
+};
+
+constexpr std::array<FoldedName, KNOWN_HEADER_COUNT> make_folded_names() {
+    std::array<FoldedName, KNOWN_HEADER_COUNT> folded{};
+    for (size_t i = 0; i < KNOWN_HEADER_COUNT; ++i) {
+        for (size_t j = 0; j < KNOWN_NAMES[i].size(); ++j) {
+            char c = KNOWN_NAMES[i][j];
+            bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            folded[i].name[j] = c;
+            folded[i].fold[j] = letter ? 0xDF : 0xFF;
+        }
+    }
+    return folded;
+}
+
+constexpr std::array<FoldedName, KNOWN_HEADER_COUNT> FOLDED_NAMES = make_folded_names();
+
+template <typename Word>
+bool folded_equal_at(const char* text, const FoldedName& known, size_t offset) {
+    Word a, b, fold;
+    std::memcpy(&a, text + offset, sizeof(Word));
+    std::memcpy(&b, known.name.data() + offset, sizeof(Word));
+    std::memcpy(&fold, known.fold.data() + offset, sizeof(Word));
+    return ((a ^ b) & fold) == 0;
+}
+
+// Compares in words; the last word overlaps the previous one instead of reading
+// past the end of `name`.
+bool folded_equal(std::string_view name, const FoldedName& known) {
+    if (name.size() < 8) {
+        return folded_equal_at<uint32_t>(name.data(), known, 0) &&
+               folded_equal_at<uint32_t>(name.data(), known, name.size() - 4);
+    }
+    for (size_t offset = 0; offset + 8 < name.size(); offset += 8) {
+        if (!folded_equal_at<uint64_t>(name.data(), known, offset)) {
+            return false;
+        }
+    }
+    return folded_equal_at<uint64_t>(name.data(), known, name.size() - 8);
+}
+
+char ascii_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<KnownHeader> find_known_header(std::string_view name) {
+    if (name.size() < MIN_KNOWN_LENGTH || name.size() > MAX_KNOWN_LENGTH) {
+        return std::nullopt;
+    }
+    uint8_t candidate = HASH_TABLE[name_hash(name)];
+    if (candidate == NO_HEADER || KNOWN_NAMES[candidate].size() != name.size() ||
+        !folded_equal(name, FOLDED_NAMES[candidate])) {
+        return std::nullopt;
+    }
+    return static_cast<KnownHeader>(candidate);
+}
+
+std::string_view known_header_name(KnownHeader header) {
+    return KNOWN_NAMES[static_cast<size_t>(header)];
+}
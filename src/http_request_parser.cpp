@@ -1,9 +1,39 @@
 #include "../include/http_request_parser.hpp"
 #include "../include/logger.hpp"
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <format>
 #include <optional>
-#include <sstream>
+
+namespace {
+
+// tchar from RFC 9110 5.6.2: what a field name may consist of.
+constexpr std::array<bool, 256> make_token_table() {
+    std::array<bool, 256> table{};
+    for (int c = '0'; c <= '9'; ++c) table[c] = true;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+    for (int c = 'a'; c <= 'z'; ++c) table[c] = true;
+    for (char c : std::string_view("!#$%&'*+-.^_`|~")) table[static_cast<unsigned char>(c)] = true;
+    return table;
+}
+
+constexpr std::array<bool, 256> TOKEN_CHARS = make_token_table();
+
+bool is_token(std::string_view text) {
+    for (char c : text) {
+        if (!TOKEN_CHARS[static_cast<unsigned char>(c)]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+}
 
 HttpRequestParser::HttpRequestParser() {
     reset();
@@ -11,163 +41,173 @@ HttpRequestParser::HttpRequestParser() {
 
 void HttpRequestParser::reset() {
     state_ = ParseState::REQUEST_LINE;
-    buffer_.clear();
-    request_ = {};
+    scanner_.reset();
+    head_base_ = nullptr;
+    head_size_ = 0;
+    content_length_ = 0;
+    // Clear field by field so the header vector keeps its capacity between requests.
+    request_.method = RequestMethod::GET;
+    request_.full_route = {};
+    request_.route = {};
+    request_.version = {};
+    request_.headers.clear();
+    request_.query_params.clear();
+    request_.path_params.clear();
+    request_.body = {};
+}
+
+const HttpRequest& HttpRequestParser::get_request() const {
+    return request_;
 }
 
-HttpRequest HttpRequestParser::get_request() const {
+HttpRequest& HttpRequestParser::get_request() {
     return request_;
 }
 
-bool HttpRequestParser::parse(const std::string& data) {
-    buffer_.append(data);
+size_t HttpRequestParser::consumed() const {
+    return state_ == ParseState::COMPLETE ? head_size_ + content_length_ : 0;
+}
 
+bool HttpRequestParser::in_body() const {
+    return state_ == ParseState::BODY;
+}
+
+bool HttpRequestParser::failed() const {
+    return state_ == ParseState::FAILED;
+}
+
+bool HttpRequestParser::parse(std::string_view data) {
     if (state_ == ParseState::REQUEST_LINE || state_ == ParseState::HEADERS) {
-        size_t header_end_pos = buffer_.find("\r\n\r\n");
-        if (header_end_pos != std::string::npos) {
-            std::string header_data = buffer_.substr(0, header_end_pos);
-            parse_headers(header_data);
-            
-            buffer_.erase(0, header_end_pos + 4);
-            state_ = ParseState::BODY;
+        if (!scanner_.scan(data)) {
+            return false;
         }
+        head_size_ = scanner_.head_size();
+        head_base_ = data.data();
+        if (scanner_.invalid() || !parse_headers(data) || !parse_content_length()) {
+            state_ = ParseState::FAILED;
+            return false;
+        }
+        state_ = ParseState::BODY;
     }
 
     if (state_ == ParseState::BODY) {
-        size_t content_length = get_content_length();
-        if (buffer_.size() >= content_length) {
-            request_.body = buffer_.substr(0, content_length);
-            buffer_.erase(0, content_length);
-            state_ = ParseState::COMPLETE;
+        if (data.size() - head_size_ < content_length_) {
+            return false;
+        }
+        if (data.data() != head_base_) {
+            // The buffer moved while the body was arriving; re-point the head views.
+            request_.headers.clear();
+            request_.query_params.clear();
+            head_base_ = data.data();
+            parse_headers(data);
         }
+        request_.body = data.substr(head_size_, content_length_);
+        state_ = ParseState::COMPLETE;
     }
 
     return state_ == ParseState::COMPLETE;
 }
 
-void HttpRequestParser::parse_headers(const std::string& header_data) {
-    std::istringstream header_stream(header_data);
-    std::string line;
-    bool is_first_line = true;
-    while (std::getline(header_stream, line) && !line.empty() && line[0] != '\r') {
-        if (line.back() == '\r') line.pop_back();
-        
-        if (is_first_line) {
-            parse_request_line(line);
-            is_first_line = false;
-        } else {
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                // Find the start of the value, skipping whitespace
-                size_t value_start = line.find_first_not_of(" \t", colon_pos + 1);
-                if (value_start != std::string::npos) {
-                    std::string key = line.substr(0, colon_pos);
-                    std::string value = line.substr(value_start);
-                    request_.headers[key] = value;
-                }
-            }
+bool HttpRequestParser::parse_headers(std::string_view head) {
+    // The scanner's line offsets are relative to the request, so a moved buffer is
+    // re-pointed without scanning it again.
+    const std::vector<HeadLine>& lines = scanner_.lines();
+    if (lines.empty()) {
+        return false;
+    }
+    parse_request_line(head.substr(lines[0].start, lines[0].end - lines[0].start));
+    for (size_t i = 1; i < lines.size(); ++i) {
+        const HeadLine& line = lines[i];
+        if (line.colon == HeadScanner::NO_COLON) {
+            return false;
+        }
+        std::string_view name = head.substr(line.start, line.colon - line.start);
+        if (name.empty() || !is_token(name)) {
+            return false;
+        }
+        std::string_view value = head.substr(line.colon + 1, line.end - line.colon - 1);
+        while (!value.empty() && is_whitespace(value.front())) value.remove_prefix(1);
+        while (!value.empty() && is_whitespace(value.back())) value.remove_suffix(1);
+        if (!value.empty()) {
+            request_.headers.add(name, value);
         }
     }
+    return true;
 }
 
-void HttpRequestParser::parse_request_line(const std::string& line) {
-    std::istringstream iss(line);
-    std::string method_str;
-    iss >> method_str >> request_.full_route >> request_.version;
-
-    static const std::map<std::string, RequestMethod> method_map = {
-        {"GET", RequestMethod::GET}, {"POST", RequestMethod::POST}, 
-        {"PUT", RequestMethod::PUT}, {"DELETE", RequestMethod::DELETE},
-        {"HEAD", RequestMethod::HEAD}, {"OPTIONS", RequestMethod::OPTIONS}
+void HttpRequestParser::parse_request_line(std::string_view line) {
+    auto next_token = [&line]() {
+        size_t start = line.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            line = {};
+            return std::string_view{};
+        }
+        line.remove_prefix(start);
+        size_t end = std::min(line.find(' '), line.size());
+        std::string_view token = line.substr(0, end);
+        line.remove_prefix(end);
+        return token;
     };
-    auto it = method_map.find(method_str);
-    if (it != method_map.end()) {
-        request_.method = it->second;
-    }
+    std::string_view method_str = next_token();
+    request_.full_route = next_token();
+    request_.version = next_token();
+
+    if (method_str == "GET") request_.method = RequestMethod::GET;
+    else if (method_str == "POST") request_.method = RequestMethod::POST;
+    else if (method_str == "PUT") request_.method = RequestMethod::PUT;
+    else if (method_str == "DELETE") request_.method = RequestMethod::DELETE;
+    else if (method_str == "HEAD") request_.method = RequestMethod::HEAD;
+    else if (method_str == "OPTIONS") request_.method = RequestMethod::OPTIONS;
 
     size_t query_pos = request_.full_route.find('?');
-    if (query_pos != std::string::npos) {
+    if (query_pos != std::string_view::npos) {
         request_.route = request_.full_route.substr(0, query_pos);
-        std::string query_string = request_.full_route.substr(query_pos + 1);
-        parse_query_params(query_string);
+        request_.query_params.assign(request_.full_route.substr(query_pos + 1));
     } else {
         request_.route = request_.full_route;
     }
 }
 
-void HttpRequestParser::parse_query_params(const std::string& query_string) {
-    if(query_string.empty()) {
-        return;
-    }
-    std::istringstream ss(query_string);
-    std::string pair;
-    while (std::getline(ss, pair, '&')) {
-        if(pair.empty()) {
-            continue;
-        }
-        size_t eq_pos = pair.find('=');
-        std::string key, value;
-        if(eq_pos != std::string::npos) {
-            key = pair.substr(0, eq_pos);
-            value = pair.substr(eq_pos + 1);
-        } else {
-            key = pair;
-            value = "";
-        }
-        key = url_decode(key);
-        value = url_decode(value);
-        request_.query_params[key] = value;
-    }
-}
-
-std::string HttpRequestParser::url_decode(const std::string& encoded) {
+std::string HttpRequestParser::url_decode(std::string_view encoded) {
     std::string decoded;
     decoded.reserve(encoded.size());
-    for (size_t i = 0; i < encoded.size(); ++i) {
-        if (encoded[i] == '%' && i + 2 < encoded.size()) {
-            std::string hex = encoded.substr(i + 1, 2);
-            
-            try {
-                int value = std::stoi(hex, nullptr, 16);
-                decoded += static_cast<char>(value);
-                i += 2; 
-            } catch (const std::exception&) {
-                decoded += encoded[i];
-            }
-        } else if (encoded[i] == '+') {
-            decoded += ' ';
-        } else {
-            decoded += encoded[i];
-        }
-    }
+    append_url_decoded(decoded, encoded, true);
     return decoded;
 }
 
-size_t HttpRequestParser::get_content_length() {
-    auto it = request_.headers.find("Content-Length");
-    if (it != request_.headers.end()) {
-        try {
-            return std::stoul(it->second);
-        } catch (...) {
-            return 0;
-        }
+bool HttpRequestParser::parse_content_length() {
+    content_length_ = 0;
+    auto header = request_.get_header(KnownHeader::ContentLength);
+    if (!header.has_value()) {
+        return true;
     }
-    return 0;
+    // The whole value must be digits: reading "10abc" as 10, or garbage as 0, would
+    // frame the body bytes as the next pipelined request.
+    const char* end = header->data() + header->size();
+    auto [ptr, ec] = std::from_chars(header->data(), end, content_length_);
+    return !header->empty() && ec == std::errc() && ptr == end;
 }
 
-std::optional<std::string> HttpRequest::get_query_param(const std::string& key) const {
-    auto it = query_params.find(key);
-    if(it == query_params.end()) {
+std::optional<std::string_view> HttpRequest::get_query_param(std::string_view key) const {
+    return query_params.get(key);
+}
+
+std::optional<std::string_view> HttpRequest::get_path_param(std::string_view key) const {
+    return path_params.get(key);
+}
+
+std::optional<std::string_view> HttpRequest::get_header(std::string_view key) const {
+    const std::string_view* value = headers.find(key);
+    if (value == nullptr) {
         return std::nullopt;
     }
-    return std::make_optional(it->second);
+    return *value;
 }
 
-
-std::optional<std::string> HttpRequest::get_path_param(const std::string& key) const {
-    auto it = path_params.find(key);
-    if(it == path_params.end()) {
+std::optional<std::string_view> HttpRequest::get_header(KnownHeader key) const {
+    const std::string_view* value = headers.find(key);
+    if (value == nullptr) {
         return std::nullopt;
     }
-    return std::make_optional(it->second);
+    return *value;
 }
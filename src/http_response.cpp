@@ -1,8 +1,73 @@
 #include "../include/http_response.hpp"
+#include "../include/file_cache.hpp"
+#include "../include/request_arena.hpp"
+#include <charconv>
+#include <unistd.h>
 #include <optional>
-#include <sstream>
 #include <string>
-#include <unordered_map>
+
+BodySegment::BodySegment(std::string data): owned_(std::move(data)), length_(owned_.size()) {}
+
+BodySegment::BodySegment(std::shared_ptr<const std::string> data)
+    : shared_(std::move(data)), length_(shared_ ? shared_->size() : 0) {}
+
+BodySegment::BodySegment(std::shared_ptr<const OpenFile> file, uint64_t offset, size_t length)
+    : file_(std::move(file)), offset_(offset), length_(file_ ? length : 0) {}
+
+std::string_view BodySegment::view() const {
+    if (file_) {
+        return {};
+    }
+    return shared_ ? std::string_view(*shared_).substr(offset_, length_) : std::string_view(owned_);
+}
+
+size_t BodySegment::size() const {
+    return length_;
+}
+
+bool BodySegment::is_file() const {
+    return file_ != nullptr;
+}
+
+const OpenFile* BodySegment::file() const {
+    return file_.get();
+}
+
+uint64_t BodySegment::file_offset() const {
+    return offset_;
+}
+
+void BodySegment::append_to(std::string& out) const {
+    if (!file_) {
+        out += view();
+        return;
+    }
+    size_t start = out.size();
+    out.resize(start + length_);
+    size_t done = 0;
+    while (done < length_) {
+        ssize_t n = pread(file_->fd, out.data() + start + done, length_ - done, static_cast<off_t>(offset_ + done));
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    out.resize(start + done);
+}
+
+BodySegment BodySegment::slice(uint64_t offset, size_t length) const {
+    if (!shared_ && !file_) {
+        return BodySegment(owned_.substr(offset, length));
+    }
+    BodySegment part = *this;
+    part.offset_ += offset;
+    part.length_ = length;
+    return part;
+}
+
+HttpResponse::HttpResponse(): HttpResponse(RequestArena::current()) {}
+
+HttpResponse::HttpResponse(std::pmr::memory_resource* resource): body_(resource) {}
 
 void HttpResponse::set_status(HttpStatusCode code) {
     status_.set_status(code);
@@ -16,47 +81,146 @@ void HttpResponse::set_status(const HttpStatus& status) {
     status_ = status;
 }
 
-void HttpResponse::set_header(const std::string& key, const std::string& value) {
-    headers[key] = value;
+const HttpStatus& HttpResponse::get_status() const {
+    return status_;
+}
+
+void HttpResponse::set_header(std::string_view key, std::string_view value) {
+    headers.set(key, make_text(value));
+}
+
+void HttpResponse::set_header(KnownHeader key, std::string_view value) {
+    headers.set(key, make_text(value));
+}
+
+std::optional<std::string> HttpResponse::get_header(std::string_view key) const {
+    const std::pmr::string* value = headers.find(key);
+    if (value == nullptr) {
+        return std::nullopt;
+    }
+    return std::string(*value);
 }
 
-std::optional<std::string> HttpResponse::get_header(const std::string& key) const {
-    auto it = headers.find(key);
-    if (it == headers.end()) {
+std::optional<std::string> HttpResponse::get_header(KnownHeader key) const {
+    const std::pmr::string* value = headers.find(key);
+    if (value == nullptr) {
         return std::nullopt;
     }
-    return std::make_optional(it->second);
+    return std::string(*value);
+}
+
+void HttpResponse::remove_header(std::string_view key) {
+    headers.remove(key);
+}
+
+void HttpResponse::remove_header(KnownHeader key) {
+    headers.remove(key);
 }
 
 void HttpResponse::set_content_type(MimeType mime_type) {
-    std::string content_type_str = mime_type_to_string(mime_type);
-    set_header("Content-Type", content_type_str);
+    set_header(KnownHeader::ContentType, mime_type_to_string(mime_type));
 }
 
 void HttpResponse::set_content_type(const std::string& mime_type) {
-    set_header("Content-Type", mime_type);
+    set_header(KnownHeader::ContentType, mime_type);
 }
 
 void HttpResponse::set_body(const std::string& body) {
-    body_ = body;
+    set_body(std::string(body));
+}
+
+void HttpResponse::set_body(std::string&& body) {
+    body_.clear();
+    append_body(BodySegment(std::move(body)));
+}
+
+void HttpResponse::set_body(std::shared_ptr<const std::string> body) {
+    body_.clear();
+    append_body(BodySegment(std::move(body)));
+}
+
+void HttpResponse::append_body(BodySegment segment) {
+    if (segment.size() > 0) {
+        body_.push_back(std::move(segment));
+    }
 }
 
 std::string HttpResponse::get_body() const {
+    std::string body;
+    body.reserve(body_size());
+    for (const auto& segment: body_) {
+        segment.append_to(body);
+    }
+    return body;
+}
+
+size_t HttpResponse::body_size() const {
+    size_t size = 0;
+    for (const auto& segment: body_) {
+        size += segment.size();
+    }
+    return size;
+}
+
+BodySegments& HttpResponse::body_segments() {
     return body_;
 }
 
-std::string HttpResponse::to_string() {
-    std::ostringstream oss;
-    oss << "HTTP/1.1 " << status_.as_string() << "\r\n";
-    if (!body_.empty() && headers.find("Content-Length") == headers.end()) {
-        headers["Content-Length"] = std::to_string(body_.size());
+std::pmr::string HttpResponse::make_text(std::string_view text) const {
+    // Allocated like the body segment list, from the response's resource.
+    return std::pmr::string(text, body_.get_allocator());
+}
+
+void HttpResponse::serialize_head(std::string& out) {
+    append_status_line(out);
+    append_fields(out, true);
+}
+
+void HttpResponse::serialize_head(std::string& out, const CommonHeaders& common, bool keep_alive) {
+    append_status_line(out);
+    common.append_to(out, keep_alive, !headers.contains(KnownHeader::Server), !headers.contains(KnownHeader::Date));
+    append_fields(out, false);
+}
+
+void HttpResponse::append_status_line(std::string& out) const {
+    std::string_view line = status_.status_line();
+    if (!line.empty()) [[likely]] {
+        out += line;
+        return;
+    }
+    out += "HTTP/1.1 ";
+    out += status_.as_string();
+    out += "\r\n";
+}
+
+void HttpResponse::append_fields(std::string& out, bool with_connection) {
+    // Always sent, even for an empty body, so keep-alive clients know where the
+    // response ends. A 304 has no body and its length would describe the 200; a
+    // chunked body is delimited by its last chunk.
+    bool has_body = status_.get_status() != HttpStatusCode::NotModified;
+    bool chunked = headers.contains(KnownHeader::TransferEncoding);
+    if (has_body && !chunked && !headers.contains(KnownHeader::ContentLength)) {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), body_size());
+        headers.set(KnownHeader::ContentLength, make_text(std::string_view(digits, end - digits)));
     }
-    for (const auto& [key, val]: headers) {
-        oss << key << ": " << val << "\r\n";
+    for (const auto& field: headers) {
+        if (!with_connection && field.known == KnownHeader::Connection) {
+            continue;
+        }
+        out += field.get_name();
+        out += ": ";
+        out += field.value;
+        out += "\r\n";
     }
-    oss << "\r\n";
-    if (!body_.empty()) {
-        oss << body_;
+    out += "\r\n";
+}
+
+std::string HttpResponse::to_string() {
+    std::string out;
+    serialize_head(out);
+    for (const auto& segment: body_) {
+        segment.append_to(out);
     }
-    return oss.str();
+    return out;
 }
@@ -10,24 +10,25 @@
 
 std::atomic<bool> HttpServer::running(true);
 int HttpServer::socket_fd = -1;
+HttpServer* HttpServer::active_server = nullptr;
 
 void signal_handler(int signal) {
     if (signal == SIGINT) {
         Logger::get_instance().info("Received SIGINT, initiating shutdown");
-        HttpServer::running = false;
-        if (HttpServer::socket_fd != -1) {
-            shutdown(HttpServer::socket_fd, SHUT_RD);
-            close(HttpServer::socket_fd);
-            HttpServer::socket_fd = -1; 
+        if (HttpServer::active_server != nullptr) {
+            HttpServer::active_server->stop();
+        } else {
+            HttpServer::running = false;
         }
     }
 }
 
 HttpServer::HttpServer(int port, size_t number_threads)
-    : port(port), keep_alive_timeout(10), next_loop(0) {
+    : port(port), accept_mode(AcceptMode::ACCEPTOR_THREAD), io_backend(IoBackend::EPOLL), io_uring_loops(0), next_loop(0), worker_threads(number_threads * 4),
+      metrics_enabled(false) {
 
     for (size_t i = 0; i < number_threads; ++i) {
-        event_loops.push_back(std::make_unique<EventLoop>(router, keep_alive_timeout));
+        event_loops.push_back(std::make_unique<EventLoop>(router, timeouts));
     }
     struct sigaction sa;
     sa.sa_handler = signal_handler;
@@ -37,6 +38,9 @@ HttpServer::HttpServer(int port, size_t number_threads)
 }
 
 HttpServer::~HttpServer() {
+    if (active_server == this) {
+        active_server = nullptr;
+    }
     if (HttpServer::socket_fd > 0) {
         close(HttpServer::socket_fd);
         HttpServer::socket_fd = -1;
@@ -44,34 +48,128 @@ HttpServer::~HttpServer() {
 }
 
 void HttpServer::set_keep_alive_timeout(int seconds) {
-    keep_alive_timeout = seconds;
+    timeouts.keep_alive = std::chrono::seconds(seconds);
+}
+
+void HttpServer::set_timeouts(const TimeoutConfig& config) {
+    timeouts = config;
+}
+
+void HttpServer::stop() {
+    running = false;
+    if (socket_fd != -1) {
+        shutdown(socket_fd, SHUT_RD);
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    for (auto& loop : event_loops) {
+        loop->wake();
+    }
+}
+
+void HttpServer::set_accept_mode(AcceptMode mode) {
+    accept_mode = mode;
+}
+
+void HttpServer::set_io_backend(IoBackend backend) {
+    io_backend = backend;
+}
+
+size_t HttpServer::get_io_uring_loops() const {
+    return io_uring_loops.load(std::memory_order_relaxed);
+}
+
+void HttpServer::set_worker_threads(size_t count) {
+    worker_threads = count;
+}
+
+WorkerPoolStats HttpServer::get_worker_stats() const {
+    return worker_pool ? worker_pool->get_stats() : WorkerPoolStats{};
+}
+
+void HttpServer::enable_metrics(const std::string& path) {
+    metrics_enabled = true;
+    router.add_route(RequestMethod::GET, path, [this](const HttpRequest&) {
+        HttpResponse response;
+        response.set_content_type("text/plain; version=0.0.4; charset=utf-8");
+        response.set_body(get_metrics());
+        return response;
+    });
+}
+
+std::string HttpServer::get_metrics() const {
+    std::vector<const LoopMetrics*> loops;
+    for (const auto& loop : event_loops) {
+        loops.push_back(&loop->get_metrics());
+    }
+    return render_metrics(router.get_routes(), loops);
+}
+
+int HttpServer::open_listener(bool reuse_port, bool non_blocking) const {
+    int type = SOCK_STREAM | SOCK_CLOEXEC | (non_blocking ? SOCK_NONBLOCK : 0);
+    int fd = socket(AF_INET, type, 0);
+    if (fd < 0) throw std::runtime_error("Failed to create socket");
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        close(fd);
+        throw std::runtime_error("failed to enable SO_REUSEPORT");
+    }
+    struct sockaddr_in server_addr = {};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        close(fd);
+        throw std::runtime_error(std::format("failed to bind on port: {}", port));
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        throw std::runtime_error("failed to listen on socket");
+    }
+    return fd;
 }
 
 bool HttpServer::start() {
     Logger& logger = Logger::get_instance();
     logger.set_level(LogLevel::INFO);
-    try {
-        socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (socket_fd < 0) throw std::runtime_error("Failed to create socket");
-        int opt = 1;
-        setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-        struct sockaddr_in server_addr = {};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port);
-        server_addr.sin_addr.s_addr = INADDR_ANY;
-        if (bind(socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            throw std::runtime_error(std::format("failed to bind on port: {}", port));
+    active_server = this;
+    if (router.has_blocking_routes() && !worker_pool) {
+        worker_pool = std::make_unique<WorkerPool>(router, worker_threads);
+    }
+    for (auto& loop : event_loops) {
+        loop->set_timeouts(timeouts);
+        loop->set_worker_pool(worker_pool.get());
+        if (metrics_enabled && !loop->get_metrics().enabled()) {
+            // Sized here, once every route is registered.
+            loop->get_metrics().enable(router.get_routes().size());
         }
-        if (listen(socket_fd, 128) < 0) {
-            throw std::runtime_error("failed to listen on socket");
+        if (io_backend == IoBackend::IO_URING && loop->use_io_uring()) {
+            io_uring_loops.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    try {
+        if (accept_mode == AcceptMode::REUSEPORT) {
+            for (auto& loop : event_loops) {
+                loop->add_listener(open_listener(true, true), true, false);
+            }
+        } else {
+            socket_fd = open_listener(false, accept_mode == AcceptMode::EPOLL_EXCLUSIVE);
+            if (accept_mode == AcceptMode::EPOLL_EXCLUSIVE) {
+                for (auto& loop : event_loops) {
+                    loop->add_listener(socket_fd, false, true);
+                }
+            }
         }
-        logger.info(std::format("Server starting... listening on port {}", port));
+        logger.info("Server starting... listening on port {}", port);
         for (auto& loop : event_loops) {
             threads.emplace_back([&]() {
                 loop->run();
             });
         }
-        run();
+        if (accept_mode == AcceptMode::ACCEPTOR_THREAD) {
+            run();
+        }
         for (auto& t : threads) {
             if (t.joinable()) {
                 t.join();
@@ -81,7 +179,7 @@ bool HttpServer::start() {
 
         return true;
     } catch (const std::exception& e) {
-        logger.error(std::format("server failed on start: {}", e.what()));
+        logger.error("server failed on start: {}", e.what());
         return false;
     }
 }
@@ -89,9 +187,9 @@ bool HttpServer::start() {
 void HttpServer::run() {
     Logger& logger = Logger::get_instance();
     while (running) {
-        int client_fd = accept(socket_fd, nullptr, nullptr);
+        int client_fd = accept4(socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
         if (client_fd < 0) {
-            if (running) logger.error(std::format("Accept failed: {}", strerror(errno)));
+            if (running) logger.error("Accept failed: {}", strerror(errno));
             continue;
         }
 
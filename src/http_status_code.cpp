@@ -1,31 +1,72 @@
 #include "../include/http_status_code.hpp"
-#include <unordered_map>
+#include <array>
+
+namespace {
+
+constexpr std::string_view LINE_PREFIX = "HTTP/1.1 ";
+constexpr unsigned int MAX_CODE = 600;
+
+struct StatusLine {
+    HttpStatusCode code;
+    std::string_view line;
+};
+
+constexpr StatusLine STATUS_LINES[] = {
+    {HttpStatusCode::Continue, "HTTP/1.1 100 Continue\r\n"},
+    {HttpStatusCode::OK, "HTTP/1.1 200 OK\r\n"},
+    {HttpStatusCode::Created, "HTTP/1.1 201 Created\r\n"},
+    {HttpStatusCode::Accepted, "HTTP/1.1 202 Accepted\r\n"},
+    {HttpStatusCode::NonAuthoritativeInformation, "HTTP/1.1 203 Non-Authoritative Information\r\n"},
+    {HttpStatusCode::NoContent, "HTTP/1.1 204 No Content\r\n"},
+    {HttpStatusCode::PartialContent, "HTTP/1.1 206 Partial Content\r\n"},
+    {HttpStatusCode::MovedPermanently, "HTTP/1.1 301 Moved Permanently\r\n"},
+    {HttpStatusCode::Found, "HTTP/1.1 302 Found\r\n"},
+    {HttpStatusCode::NotModified, "HTTP/1.1 304 Not Modified\r\n"},
+    {HttpStatusCode::BadRequest, "HTTP/1.1 400 Bad Request\r\n"},
+    {HttpStatusCode::Unauthorized, "HTTP/1.1 401 Unauthorized\r\n"},
+    {HttpStatusCode::Forbidden, "HTTP/1.1 403 Forbidden\r\n"},
+    {HttpStatusCode::NotFound, "HTTP/1.1 404 Not Found\r\n"},
+    {HttpStatusCode::RangeNotSatisfiable, "HTTP/1.1 416 Range Not Satisfiable\r\n"},
+    {HttpStatusCode::InternalServerError, "HTTP/1.1 500 Internal Server Error\r\n"},
+    {HttpStatusCode::NotImplemented, "HTTP/1.1 501 Not Implemented\r\n"}
+};
+
+// Indexed by the numeric code, so finding a line is one load.
+constexpr std::array<std::string_view, MAX_CODE> make_line_table() {
+    std::array<std::string_view, MAX_CODE> table{};
+    for (const StatusLine& status: STATUS_LINES) {
+        table[static_cast<unsigned int>(status.code)] = status.line;
+    }
+    return table;
+}
+
+constexpr std::array<std::string_view, MAX_CODE> LINES_BY_CODE = make_line_table();
+
+constexpr bool lines_match_codes() {
+    for (const StatusLine& status: STATUS_LINES) {
+        std::string_view line = status.line;
+        std::string_view digits = line.substr(LINE_PREFIX.size(), 3);
+        unsigned int code = (digits[0] - '0') * 100 + (digits[1] - '0') * 10 + (digits[2] - '0');
+        if (!line.starts_with(LINE_PREFIX) || !line.ends_with("\r\n") || line[LINE_PREFIX.size() + 3] != ' ' ||
+            code != static_cast<unsigned int>(status.code)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(lines_match_codes(), "a status line does not carry its own code");
+
+std::string_view line_for(unsigned int code) {
+    return code < MAX_CODE ? LINES_BY_CODE[code] : std::string_view{};
+}
+
+}
 
 HttpStatus::HttpStatus(HttpStatusCode code): code_(code) {}
 
 HttpStatus::HttpStatus(unsigned int code) {
-    static const std::unordered_map<unsigned int, HttpStatusCode> code_map = {
-        {100, HttpStatusCode::Continue},
-        {200, HttpStatusCode::OK},
-        {201, HttpStatusCode::Created},
-        {202, HttpStatusCode::Accepted},
-        {203, HttpStatusCode::NonAuthoritativeInformation},
-        {204, HttpStatusCode::NoContent},
-        {301, HttpStatusCode::MovedPermanently},
-        {302, HttpStatusCode::Found},
-        {400, HttpStatusCode::BadRequest},
-        {401, HttpStatusCode::Unauthorized},
-        {403, HttpStatusCode::Forbidden},
-        {404, HttpStatusCode::NotFound},
-        {500, HttpStatusCode::InternalServerError},
-        {501, HttpStatusCode::NotImplemented}
-    };
-    auto it = code_map.find(code);
-    if (it == code_map.end()) {
-        code_ = HttpStatusCode::InternalServerError;
-    } else {
-        code_ = it->second;
-    }
+    code_ = line_for(code).empty() ? HttpStatusCode::InternalServerError : static_cast<HttpStatusCode>(code);
 }
 
 HttpStatusCode HttpStatus::get_status() const { 
@@ -45,30 +86,17 @@ void HttpStatus::set_status(unsigned int code) {
 }
 
 std::string HttpStatus::as_string() const {
-    static const std::unordered_map<HttpStatusCode, std::string> status_text = {
-        {HttpStatusCode::Continue, "100 Continue"},
-        {HttpStatusCode::OK, "200 OK"},
-        {HttpStatusCode::Created, "201 Created"},
-        {HttpStatusCode::Accepted, "202 Accepted"},
-        {HttpStatusCode::NonAuthoritativeInformation, "203 Non-Authoritative Information"},
-        {HttpStatusCode::NoContent, "204 No Content"},
-        {HttpStatusCode::MovedPermanently, "301 Moved Permanently"},
-        {HttpStatusCode::Found, "302 Found"},
-        {HttpStatusCode::BadRequest, "400 Bad Request"},
-        {HttpStatusCode::Unauthorized, "401 Unauthorized"},
-        {HttpStatusCode::Forbidden, "403 Forbidden"},
-        {HttpStatusCode::NotFound, "404 Not Found"},
-        {HttpStatusCode::InternalServerError, "500 Internal Server Error"},
-        {HttpStatusCode::NotImplemented, "501 Not Implemented"}
-    };
-
-    auto it = status_text.find(code_);
-    if (it != status_text.end()) {
-        return it->second;
+    std::string_view line = status_line();
+    if (!line.empty()) {
+        return std::string(line.substr(LINE_PREFIX.size(), line.size() - LINE_PREFIX.size() - 2));
     }
     return std::to_string(static_cast<unsigned int>(code_)) + " Unknown Status";
 }
 
+std::string_view HttpStatus::status_line() const {
+    return line_for(static_cast<unsigned int>(code_));
+}
+
 bool HttpStatus::is_informational() const {
     auto as_number = static_cast<unsigned int>(code_);
     return (as_number >= 100 && as_number < 200);
@@ -0,0 +1,308 @@
+#include "../include/io_uring.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <initializer_list>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Marks the completions of the multishot receive the constructor probes with.
+constexpr uint64_t PROBE_USER_DATA = ~0ULL;
+constexpr int PROBE_TIMEOUT_MS = 1000;
+
+// Asks the kernel which opcodes it implements rather than guessing from its
+// version, which backports and vendor kernels make unreliable.
+bool opcodes_supported(int ring_fd, std::initializer_list<uint8_t> opcodes) {
+    std::vector<char> storage(sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+    auto* probe = reinterpret_cast<struct io_uring_probe*>(storage.data());
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+        return false;
+    }
+    for (uint8_t opcode: opcodes) {
+        if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void* map_ring(int fd, size_t size, off_t offset) {
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error(std::format("io_uring mmap failed: {}", strerror(errno)));
+    }
+    return map;
+}
+
+}
+
+IoUring::IoUring(unsigned entries, unsigned buffer_count, size_t buffer_size)
+    : ring_fd(-1), sq_map(nullptr), sq_map_size(0), sqes(nullptr), sqes_size(0), sq_local_tail(0), sq_submitted(0),
+      cq_map(nullptr), cq_map_size(0), buf_ring(nullptr), buf_ring_size(0), buffers(nullptr),
+      buffer_count(buffer_count), buffer_size(buffer_size), buf_tail(0) {
+    struct io_uring_params params = {};
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd < 0) {
+        throw std::runtime_error(std::format("io_uring_setup failed: {}", strerror(errno)));
+    }
+    try {
+        if (!opcodes_supported(ring_fd, {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+                                         IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL})) {
+            throw std::runtime_error("io_uring lacks a required opcode");
+        }
+        sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_map && cq_map_size > sq_map_size) {
+            sq_map_size = cq_map_size;
+        }
+        sq_map = map_ring(ring_fd, sq_map_size, IORING_OFF_SQ_RING);
+        cq_map = single_map ? sq_map : map_ring(ring_fd, cq_map_size, IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe*>(map_ring(ring_fd, sqes_size, IORING_OFF_SQES));
+
+        char* sq = static_cast<char*>(sq_map);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_local_tail = *sq_tail;
+        sq_submitted = sq_local_tail;
+        // Slots map one-to-one onto SQEs, so the indirection array is filled once.
+        for (unsigned i = 0; i <= sq_mask; ++i) {
+            sq_array[i] = i;
+        }
+        char* cq = static_cast<char*>(cq_map);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Provided buffers: the kernel picks one per received segment, so idle
+        // connections hold no receive memory.
+        buf_ring_size = buffer_count * sizeof(struct io_uring_buf);
+        void* ring_memory = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring_memory == MAP_FAILED) {
+            throw std::runtime_error("failed to allocate io_uring buffer ring");
+        }
+        buf_ring = static_cast<struct io_uring_buf*>(ring_memory);
+        struct io_uring_buf_reg reg = {};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+        reg.ring_entries = buffer_count;
+        reg.bgid = BUFFER_GROUP;
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            if (errno == EINVAL) {
+                throw std::runtime_error("io_uring provided buffer rings not supported");
+            }
+            throw std::runtime_error(std::format("io_uring buffer ring registration failed: {}", strerror(errno)));
+        }
+        buffers = new char[buffer_count * buffer_size];
+        for (unsigned i = 0; i < buffer_count; ++i) {
+            recycle(static_cast<uint16_t>(i));
+        }
+        probe_multishot_recv();
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+void IoUring::probe_multishot_recv() {
+    // The opcode probe cannot tell whether RECV takes the multishot flag; a kernel
+    // without it fails the first completion with EINVAL. Try it on a socket pair
+    // holding one byte and EOF, which ends the receive after two completions.
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair) != 0) {
+        throw std::runtime_error(std::format("io_uring probe socketpair failed: {}", strerror(errno)));
+    }
+    ssize_t sent = write(pair[1], "x", 1);
+    close(pair[1]);
+    int error = sent == 1 ? 0 : EIO;
+    bool done = false;
+    recv_multishot(pair[0], PROBE_USER_DATA);
+    while (!done && error == 0) {
+        submit_and_wait(PROBE_TIMEOUT_MS);
+        bool completed = false;
+        for_each_completion([&](const struct io_uring_cqe& cqe) {
+            completed = true;
+            if (cqe.res < 0) {
+                error = -cqe.res;
+            } else if (cqe.flags & IORING_CQE_F_BUFFER) {
+                recycle(buffer_id(cqe.flags));
+            }
+            done = done || !(cqe.flags & IORING_CQE_F_MORE);
+        });
+        if (!completed) {
+            error = ETIME;
+        }
+    }
+    close(pair[0]);
+    if (error == EINVAL) {
+        throw std::runtime_error("io_uring multishot receive not supported");
+    }
+    if (error != 0) {
+        throw std::runtime_error(std::format("io_uring multishot receive probe failed: {}", strerror(error)));
+    }
+}
+
+IoUring::~IoUring() {
+    release();
+}
+
+void IoUring::release() {
+    delete[] buffers;
+    buffers = nullptr;
+    if (buf_ring != nullptr) {
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = nullptr;
+    }
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if (cq_map != nullptr && cq_map != sq_map) {
+        munmap(cq_map, cq_map_size);
+    }
+    cq_map = nullptr;
+    if (sq_map != nullptr) {
+        munmap(sq_map, sq_map_size);
+        sq_map = nullptr;
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+bool IoUring::sq_full() const {
+    return sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > sq_mask;
+}
+
+struct io_uring_sqe* IoUring::next_sqe() {
+    if (backlog.empty() && sq_full()) {
+        // Hand the queued entries to the kernel to make room.
+        submit_and_wait(0);
+    }
+    if (!backlog.empty() || sq_full()) {
+        // The kernel did not free a slot. Completions cannot be reaped from here,
+        // since this may run inside for_each_completion, so the entry waits for a
+        // later submit.
+        return &backlog.emplace_back();
+    }
+    struct io_uring_sqe* sqe = &sqes[sq_local_tail & sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail;
+    return sqe;
+}
+
+void IoUring::accept_multishot(int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void IoUring::recv_multishot(int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = user_data;
+}
+
+void IoUring::sendmsg(int fd, const struct msghdr* message, uint64_t user_data) {
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+}
+
+void IoUring::poll(int fd, uint32_t events, bool multishot, uint64_t user_data) {
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void IoUring::cancel(uint64_t target, uint64_t user_data) {
+    struct io_uring_sqe* sqe = next_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+void IoUring::drain_backlog() {
+    size_t moved = 0;
+    while (moved < backlog.size() && !sq_full()) {
+        sqes[sq_local_tail & sq_mask] = backlog[moved++];
+        ++sq_local_tail;
+    }
+    backlog.erase(backlog.begin(), backlog.begin() + moved);
+}
+
+void IoUring::submit_and_wait(int timeout_ms) {
+    if (!backlog.empty()) {
+        drain_backlog();
+    }
+    unsigned to_submit = sq_local_tail - sq_submitted;
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    if (timeout_ms == 0) {
+        if (to_submit > 0) {
+            sq_submitted += enter(to_submit, 0, 0, nullptr, 0);
+        }
+        return;
+    }
+    struct __kernel_timespec ts = {};
+    struct io_uring_getevents_arg arg = {};
+    if (timeout_ms > 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    sq_submitted += enter(to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+unsigned IoUring::enter(unsigned to_submit, unsigned min_complete, unsigned flags, const void* arg, size_t arg_size) {
+    // The kernel may take fewer entries than offered; the rest stay published past
+    // sq_submitted and go with the next call. ETIME (timeout), EINTR and EBUSY
+    // (completion ring backed up) all leave the caller to reap what is there and
+    // come back; an error means nothing was consumed.
+    long result = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+    return result > 0 ? static_cast<unsigned>(result) : 0;
+}
+
+uint16_t IoUring::buffer_id(uint32_t cqe_flags) {
+    return static_cast<uint16_t>(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+const char* IoUring::buffer(uint16_t id) const {
+    return buffers + static_cast<size_t>(id) * buffer_size;
+}
+
+void IoUring::recycle(uint16_t id) {
+    struct io_uring_buf& slot = buf_ring[buf_tail & (buffer_count - 1)];
+    slot.addr = reinterpret_cast<uint64_t>(buffers + static_cast<size_t>(id) * buffer_size);
+    slot.len = static_cast<uint32_t>(buffer_size);
+    slot.bid = id;
+    ++buf_tail;
+    // The ring's tail overlays the reserved field of its first entry.
+    __atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+}
@@ -1,13 +1,29 @@
 #include "../include/logger.hpp"
+#include <bit>
+#include <cstring>
 #include <ctime>
 #include <format>
-#include <iomanip>
 #include <iostream>
 #include <mutex>
-#include <sstream>
+
+namespace {
+
+struct ThreadRingSlot {
+    std::shared_ptr<void> ring;
+    uint64_t generation = 0;
+};
+
+thread_local ThreadRingSlot thread_ring;
+std::atomic<uint64_t> ring_generation{0};
+
+}
 
 Logger::Logger(): min_level(LogLevel::DEBUG) {}
 
+Logger::~Logger() {
+    disable_async();
+}
+
 std::string Logger::level_to_string(const LogLevel& lvl) const {
     switch (lvl) {
         case LogLevel::DEBUG:
@@ -31,45 +47,247 @@ Logger& Logger::get_instance() {
 }
 
 void Logger::set_level(const LogLevel& lvl) {
-    std::lock_guard<std::mutex> lock(mtx);
-    min_level = lvl; 
+    min_level.store(lvl, std::memory_order_relaxed);
 }
 
-std::string Logger::format_log_entry(LogLevel level, const std::string& message) {
+bool Logger::should_log(LogLevel lvl) const {
+    return lvl >= min_level.load(std::memory_order_relaxed);
+}
+
+const std::string& Logger::TimestampCache::format(std::time_t time) {
+    if (time != cached_time) {
+        std::tm local_time;
+        localtime_r(&time, &local_time);
+        char buffer[32];
+        size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S:", &local_time);
+        cached.assign(buffer, length);
+        cached_time = time;
+    }
+    return cached;
+}
 
-    auto now = std::time(nullptr);
-    auto local_time = *std::localtime(&now);
-    std::stringstream ss; 
-    ss << std::put_time(&local_time, "%Y-%m-%d %H:%M:%S:");
-    std::string timestamp = ss.str();
+std::string Logger::format_log_entry(LogLevel level, std::string_view message) {
+    const std::string& timestamp = sync_timestamps.format(std::time(nullptr));
     return std::format("[{}] [{}] {}", timestamp, level_to_string(level), message);
 }
 
-void Logger::log(LogLevel lvl, const std::string& message) {
-    if (lvl < min_level) {
+void Logger::log(LogLevel lvl, std::string_view message) {
+    if (!should_log(lvl)) {
         return;
     }
+    {
+        AsyncProducer producer(*this);
+        if (producer) {
+            LogRecord* record = acquire_record(lvl);
+            if (record != nullptr) {
+                record->length = static_cast<uint32_t>(std::min(message.size(), MAX_MESSAGE_SIZE));
+                std::memcpy(record->text, message.data(), record->length);
+                publish_record();
+            }
+            return;
+        }
+    }
     std::lock_guard<std::mutex> lock(mtx);
     std::cout << format_log_entry(lvl, message) << std::endl;
 }
 
-void Logger::debug(const std::string& message) {
+void Logger::debug(std::string_view message) {
     log(LogLevel::DEBUG, message);
 }
 
 
-void Logger::info(const std::string& message) {
+void Logger::info(std::string_view message) {
     log(LogLevel::INFO, message);
 }
 
-void Logger::warning(const std::string& message) {
+void Logger::warning(std::string_view message) {
     log(LogLevel::WARNING, message);
 }
 
-void Logger::error(const std::string& message) {
+void Logger::error(std::string_view message) {
     log(LogLevel::ERROR, message);
 }
 
-void Logger::critical(const std::string& message) {
+void Logger::critical(std::string_view message) {
     log(LogLevel::CRITICAL, message);
 }
+
+Logger::AsyncProducer::AsyncProducer(Logger& logger): logger(logger) {
+    if (!logger.async_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+    // Sequentially consistent against the exchange in disable_async: either this
+    // thread sees async mode switched off, or disable_async sees it counted.
+    logger.async_producers.fetch_add(1, std::memory_order_seq_cst);
+    if (logger.async_enabled.load(std::memory_order_seq_cst)) {
+        active = true;
+    } else {
+        logger.async_producers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+Logger::AsyncProducer::~AsyncProducer() {
+    if (active) {
+        logger.async_producers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+Logger::RecordRing::RecordRing(size_t capacity)
+    : records(std::bit_ceil(std::max<size_t>(capacity, 2))), mask(records.size() - 1) {}
+
+Logger::LogRecord* Logger::RecordRing::try_acquire() {
+    size_t current_tail = tail.load(std::memory_order_relaxed);
+    if (current_tail - head.load(std::memory_order_acquire) == records.size()) {
+        return nullptr;
+    }
+    return &records[current_tail & mask];
+}
+
+void Logger::RecordRing::publish() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <typename F>
+size_t Logger::RecordRing::drain(F&& consume) {
+    size_t current_head = head.load(std::memory_order_relaxed);
+    size_t current_tail = tail.load(std::memory_order_acquire);
+    for (size_t i = current_head; i != current_tail; ++i) {
+        consume(records[i & mask]);
+    }
+    head.store(current_tail, std::memory_order_release);
+    return current_tail - current_head;
+}
+
+Logger::LogRecord* Logger::acquire_record(LogLevel level) {
+    uint64_t generation = ring_generation.load(std::memory_order_acquire);
+    if (thread_ring.generation != generation || !thread_ring.ring) {
+        auto ring = std::make_shared<RecordRing>(async_config.ring_capacity);
+        {
+            std::lock_guard<std::mutex> lock(rings_mtx);
+            rings.push_back(ring);
+        }
+        thread_ring.ring = ring;
+        thread_ring.generation = generation;
+    }
+    auto* ring = static_cast<RecordRing*>(thread_ring.ring.get());
+    LogRecord* record = ring->try_acquire();
+    while (record == nullptr) {
+        if (async_config.overflow == LogOverflowPolicy::DROP || !async_enabled.load(std::memory_order_acquire)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        writer_cv.notify_one();
+        std::this_thread::yield();
+        record = ring->try_acquire();
+    }
+    record->time = std::time(nullptr);
+    record->level = level;
+    return record;
+}
+
+void Logger::publish_record() {
+    static_cast<RecordRing*>(thread_ring.ring.get())->publish();
+    enqueued.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Logger::enable_async(const AsyncLogConfig& config) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (async_enabled.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::FILE* file = config.path.empty() ? stdout : std::fopen(config.path.c_str(), "a");
+    if (file == nullptr) {
+        return false;
+    }
+    std::cout.flush();
+    output = file;
+    async_config = config;
+    {
+        std::lock_guard<std::mutex> rings_lock(rings_mtx);
+        rings.clear();
+    }
+    // Threads notice the new generation and register a fresh ring on their next entry.
+    ring_generation.fetch_add(1, std::memory_order_release);
+    writer_running.store(true, std::memory_order_release);
+    writer = std::thread([this]() { writer_loop(); });
+    async_enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void Logger::disable_async() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!async_enabled.exchange(false, std::memory_order_seq_cst)) {
+        return;
+    }
+    // Producers that saw async mode on may still publish; the writer is still
+    // running to make room for blocked ones, and they drop once they see it off.
+    while (async_producers.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> writer_lock(writer_mtx);
+        writer_running.store(false, std::memory_order_release);
+    }
+    writer_cv.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (output != stdout) {
+        std::fclose(output);
+    }
+    output = nullptr;
+}
+
+LoggerStats Logger::get_stats() const {
+    return LoggerStats{
+        enqueued.load(std::memory_order_relaxed),
+        written.load(std::memory_order_relaxed),
+        dropped.load(std::memory_order_relaxed)
+    };
+}
+
+size_t Logger::drain_rings(std::string& batch) {
+    size_t drained = 0;
+    std::lock_guard<std::mutex> lock(rings_mtx);
+    for (auto it = rings.begin(); it != rings.end();) {
+        // Only the writer still holds rings of threads that have exited, so
+        // this drain sees everything they published.
+        bool orphaned = it->use_count() == 1;
+        drained += (*it)->drain([&](const LogRecord& record) {
+            batch += '[';
+            batch += async_timestamps.format(record.time);
+            batch += "] [";
+            batch += level_to_string(record.level);
+            batch += "] ";
+            batch.append(record.text, record.length);
+            batch += '\n';
+        });
+        if (orphaned) {
+            it = rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return drained;
+}
+
+void Logger::writer_loop() {
+    std::string batch;
+    batch.reserve(64 * 1024);
+    bool running = true;
+    while (running) {
+        running = writer_running.load(std::memory_order_acquire);
+        size_t drained = drain_rings(batch);
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), output);
+            std::fflush(output);
+            written.fetch_add(drained, std::memory_order_relaxed);
+            batch.clear();
+        }
+        if (drained == 0 && running) {
+            std::unique_lock<std::mutex> lock(writer_mtx);
+            writer_cv.wait_for(lock, async_config.flush_interval,
+                [this]() { return !writer_running.load(std::memory_order_acquire); });
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#include "../include/metrics.hpp"
+#include <array>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace {
+
+std::string_view method_name(RequestMethod method) {
+    switch (method) {
+        case RequestMethod::GET: return "GET";
+        case RequestMethod::HEAD: return "HEAD";
+        case RequestMethod::OPTIONS: return "OPTIONS";
+        case RequestMethod::POST: return "POST";
+        case RequestMethod::DELETE: return "DELETE";
+        case RequestMethod::PUT: return "PUT";
+    }
+    return "";
+}
+
+std::string escape_label(std::string_view value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// One histogram summed over all loops.
+struct HistogramTotal {
+    std::array<uint64_t, LatencyHistogram::BUCKETS> counts{};
+    uint64_t sum_ns = 0;
+
+    void add(const LatencyHistogram& histogram) {
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            counts[i] += histogram.count(i);
+        }
+        sum_ns += histogram.sum_ns();
+    }
+};
+
+struct RouteTotal {
+    HistogramTotal parse;
+    HistogramTotal handler;
+    HistogramTotal write;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    std::array<uint64_t, 5> status_classes{};
+};
+
+void append_help(std::string& out, std::string_view name, std::string_view type, std::string_view help) {
+    out += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+// Buckets are exported at every power of two, where the log-linear buckets line
+// up exactly, to keep the number of series per route down.
+void append_histogram(std::string& out, std::string_view name, const std::string& labels, const HistogramTotal& total) {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKETS; ++i) {
+        cumulative += total.counts[i];
+        if (i > 0 && (i - 1) % LatencyHistogram::SUB_BUCKETS != LatencyHistogram::SUB_BUCKETS - 1) {
+            continue;
+        }
+        double le = static_cast<double>(LatencyHistogram::bucket_limit_ns(i)) / 1e9;
+        out += std::format("{}_bucket{{{},le=\"{}\"}} {}\n", name, labels, le, cumulative);
+    }
+    cumulative += total.counts[LatencyHistogram::BUCKETS - 1];
+    out += std::format("{}_bucket{{{},le=\"+Inf\"}} {}\n", name, labels, cumulative);
+    out += std::format("{}_sum{{{}}} {}\n", name, labels, static_cast<double>(total.sum_ns) / 1e9);
+    out += std::format("{}_count{{{}}} {}\n", name, labels, cumulative);
+}
+
+}
+
+void LoopMetrics::enable(size_t route_count) {
+    routes_ = std::make_unique<RouteMetrics[]>(route_count + 1);
+    route_count_ = route_count;
+}
+
+std::string render_metrics(const std::vector<std::pair<RequestMethod, std::string>>& routes,
+                           const std::vector<const LoopMetrics*>& loops) {
+    // Slot i of every loop belongs to routes[i]; the slot after the last route
+    // holds requests that matched none.
+    size_t slots = routes.size() + 1;
+    std::vector<RouteTotal> totals(slots);
+    for (const LoopMetrics* loop : loops) {
+        if (!loop->enabled() || loop->route_count() != routes.size()) {
+            continue;
+        }
+        for (size_t i = 0; i < slots; ++i) {
+            const RouteMetrics& recorded = loop->slot(i);
+            RouteTotal& total = totals[i];
+            total.parse.add(recorded.parse);
+            total.handler.add(recorded.handler);
+            total.write.add(recorded.write);
+            total.bytes_in += recorded.bytes_in.get();
+            total.bytes_out += recorded.bytes_out.get();
+            for (size_t c = 0; c < total.status_classes.size(); ++c) {
+                total.status_classes[c] += recorded.status_classes[c].get();
+            }
+        }
+    }
+
+    std::vector<std::string> labels(slots);
+    for (size_t i = 0; i < routes.size(); ++i) {
+        labels[i] = std::format("method=\"{}\",route=\"{}\"", method_name(routes[i].first), escape_label(routes[i].second));
+    }
+    labels[routes.size()] = "method=\"\",route=\"\"";
+    // Routes that have not served anything yet are left out.
+    auto served = [&](size_t i) {
+        for (uint64_t count : totals[i].status_classes) {
+            if (count > 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::string out;
+    append_help(out, "bcpp_requests_total", "counter", "Responses by route and status class.");
+    for (size_t i = 0; i < slots; ++i) {
+        for (size_t c = 0; c < totals[i].status_classes.size(); ++c) {
+            if (totals[i].status_classes[c] > 0) {
+                out += std::format("bcpp_requests_total{{{},status=\"{}xx\"}} {}\n",
+                                   labels[i], c + 1, totals[i].status_classes[c]);
+            }
+        }
+    }
+    append_help(out, "bcpp_request_bytes_total", "counter", "Request bytes received, head and body.");
+    for (size_t i = 0; i < slots; ++i) {
+        if (served(i)) {
+            out += std::format("bcpp_request_bytes_total{{{}}} {}\n", labels[i], totals[i].bytes_in);
+        }
+    }
+    append_help(out, "bcpp_response_bytes_total", "counter", "Response bytes queued for sending, head and body.");
+    for (size_t i = 0; i < slots; ++i) {
+        if (served(i)) {
+            out += std::format("bcpp_response_bytes_total{{{}}} {}\n", labels[i], totals[i].bytes_out);
+        }
+    }
+    struct Phase {
+        std::string_view name;
+        std::string_view help;
+        HistogramTotal RouteTotal::*histogram;
+    };
+    constexpr std::array<Phase, 3> phases{{
+        {"bcpp_parse_duration_seconds", "Time spent parsing the request.", &RouteTotal::parse},
+        {"bcpp_handler_duration_seconds", "Time from the parsed request to its queued response.", &RouteTotal::handler},
+        {"bcpp_write_duration_seconds", "Time from the queued response to its last byte sent.", &RouteTotal::write},
+    }};
+    for (const Phase& phase : phases) {
+        append_help(out, phase.name, "histogram", phase.help);
+        for (size_t i = 0; i < slots; ++i) {
+            if (served(i)) {
+                append_histogram(out, phase.name, labels[i], totals[i].*phase.histogram);
+            }
+        }
+    }
+    append_help(out, "bcpp_connections", "gauge", "Open connections per event loop, busy or idle between requests.");
+    for (size_t i = 0; i < loops.size(); ++i) {
+        uint64_t open = loops[i]->open_connections.get();
+        uint64_t idle = loops[i]->idle_connections.get();
+        // Read one after the other, so the idle count may briefly exceed the open one.
+        uint64_t active = open > idle ? open - idle : 0;
+        out += std::format("bcpp_connections{{loop=\"{}\",state=\"active\"}} {}\n", i, active);
+        out += std::format("bcpp_connections{{loop=\"{}\",state=\"idle\"}} {}\n", i, idle);
+    }
+    return out;
+}
@@ -1,4 +1,6 @@
 #include "../include/mime_type.hpp"
+#include <algorithm>
+#include <cctype>
 #include <unordered_map>
 
 std::string mime_type_to_string(MimeType mime) {
@@ -13,6 +15,13 @@ std::string mime_type_to_string(MimeType mime) {
         {MimeType::ImageJpeg, "image/jpeg"},
         {MimeType::ImagePng, "image/png"},
         {MimeType::ImageGif, "image/gif"},
+        {MimeType::ImageSvg, "image/svg+xml"},
+        {MimeType::ImageWebp, "image/webp"},
+        {MimeType::ImageIcon, "image/x-icon"},
+        {MimeType::TextCsv, "text/csv"},
+        {MimeType::FontWoff, "font/woff"},
+        {MimeType::FontWoff2, "font/woff2"},
+        {MimeType::ApplicationWasm, "application/wasm"},
         {MimeType::AudioMpeg, "audio/mpeg"},
         {MimeType::VideoMp4, "video/mp4"},
         {MimeType::MultipartFormData, "multipart/form-data"},
@@ -25,3 +34,50 @@ std::string mime_type_to_string(MimeType mime) {
     }
     return "application/octet-stream";
 }
+
+MimeType mime_type_from_path(std::string_view path) {
+    static const std::unordered_map<std::string_view, MimeType> extension_map = {
+        {"txt", MimeType::TextPlain},
+        {"html", MimeType::TextHtml},
+        {"htm", MimeType::TextHtml},
+        {"css", MimeType::TextCss},
+        {"js", MimeType::TextJavascript},
+        {"mjs", MimeType::TextJavascript},
+        {"json", MimeType::ApplicationJson},
+        {"xml", MimeType::ApplicationXml},
+        {"pdf", MimeType::ApplicationPdf},
+        {"jpg", MimeType::ImageJpeg},
+        {"jpeg", MimeType::ImageJpeg},
+        {"png", MimeType::ImagePng},
+        {"gif", MimeType::ImageGif},
+        {"svg", MimeType::ImageSvg},
+        {"webp", MimeType::ImageWebp},
+        {"ico", MimeType::ImageIcon},
+        {"csv", MimeType::TextCsv},
+        {"woff", MimeType::FontWoff},
+        {"woff2", MimeType::FontWoff2},
+        {"wasm", MimeType::ApplicationWasm},
+        {"mp3", MimeType::AudioMpeg},
+        {"mp4", MimeType::VideoMp4}
+    };
+
+    size_t name_start = path.find_last_of('/');
+    std::string_view name = name_start == std::string_view::npos ? path : path.substr(name_start + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string_view::npos || dot + 1 == name.size()) {
+        return MimeType::ApplicationOctetStream;
+    }
+    std::string_view extension = name.substr(dot + 1);
+    // Known extensions are short; anything longer cannot match.
+    char lowered[8];
+    if (extension.size() > sizeof(lowered)) {
+        return MimeType::ApplicationOctetStream;
+    }
+    std::transform(extension.begin(), extension.end(), lowered,
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    auto it = extension_map.find(std::string_view(lowered, extension.size()));
+    if (it != extension_map.end()) {
+        return it->second;
+    }
+    return MimeType::ApplicationOctetStream;
+}
@@ -0,0 +1,30 @@
+#include "../include/request_arena.hpp"
+
+namespace {
+
+thread_local std::pmr::memory_resource* current_resource = nullptr;
+
+}
+
+RequestArena::RequestArena()
+    : block(std::make_unique<std::byte[]>(BLOCK_SIZE)),
+      buffer(block.get(), BLOCK_SIZE, std::pmr::new_delete_resource()) {}
+
+std::pmr::memory_resource* RequestArena::resource() {
+    return &buffer;
+}
+
+std::pmr::memory_resource* RequestArena::current() {
+    return current_resource != nullptr ? current_resource : std::pmr::get_default_resource();
+}
+
+RequestArena::Scope::Scope(RequestArena& arena): arena(arena), previous(current_resource) {
+    current_resource = arena.resource();
+}
+
+RequestArena::Scope::~Scope() {
+    current_resource = previous;
+    // Hands back blocks taken from the heap for a large response; the first block
+    // is reused from its start.
+    arena.buffer.release();
+}
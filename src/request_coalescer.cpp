@@ -0,0 +1,66 @@
+#include "../include/request_coalescer.hpp"
+
+RequestCoalescer::Result RequestCoalescer::Flight::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    done_cv.wait(lock, [this]() { return done; });
+    return value;
+}
+
+void RequestCoalescer::Flight::subscribe(std::function<void()> on_done) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!done) {
+            subscribers.push_back(std::move(on_done));
+            return;
+        }
+    }
+    on_done();
+}
+
+RequestCoalescer::Result RequestCoalescer::Flight::result() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return value;
+}
+
+void RequestCoalescer::Flight::finish(Result result) {
+    std::vector<std::function<void()>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        value = std::move(result);
+        done = true;
+        waiting.swap(subscribers);
+    }
+    done_cv.notify_all();
+    for (auto& on_done: waiting) {
+        on_done();
+    }
+}
+
+std::pair<std::shared_ptr<RequestCoalescer::Flight>, bool> RequestCoalescer::join(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = in_flight.find(key);
+    if (it != in_flight.end()) {
+        joined.fetch_add(1, std::memory_order_relaxed);
+        return {it->second, false};
+    }
+    auto flight = std::make_shared<Flight>();
+    in_flight.emplace(key, flight);
+    led.fetch_add(1, std::memory_order_relaxed);
+    return {std::move(flight), true};
+}
+
+void RequestCoalescer::finish(const std::string& key, Flight& flight, Result result) {
+    // Requests that joined before this still get `result`; later ones start a new call.
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        in_flight.erase(key);
+    }
+    flight.finish(std::move(result));
+}
+
+CoalescerStats RequestCoalescer::get_stats() const {
+    return CoalescerStats{
+        led.load(std::memory_order_relaxed),
+        joined.load(std::memory_order_relaxed)
+    };
+}
@@ -0,0 +1,133 @@
+#include "../include/request_params.hpp"
+#include <array>
+#include <cstdint>
+
+namespace {
+
+constexpr uint8_t NOT_HEX = 0xFF;
+
+constexpr std::array<uint8_t, 256> make_hex_table() {
+    std::array<uint8_t, 256> table{};
+    table.fill(NOT_HEX);
+    for (int c = '0'; c <= '9'; ++c) table[c] = static_cast<uint8_t>(c - '0');
+    for (int c = 'a'; c <= 'f'; ++c) table[c] = static_cast<uint8_t>(c - 'a' + 10);
+    for (int c = 'A'; c <= 'F'; ++c) table[c] = static_cast<uint8_t>(c - 'A' + 10);
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> HEX_VALUES = make_hex_table();
+
+bool needs_decoding(std::string_view text) {
+    for (char c : text) {
+        if (c == '%' || c == '+') {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+void append_url_decoded(std::string& out, std::string_view encoded, bool plus_as_space) {
+    for (size_t i = 0; i < encoded.size(); ++i) {
+        char c = encoded[i];
+        if (c == '%' && i + 2 < encoded.size()) {
+            uint8_t high = HEX_VALUES[static_cast<unsigned char>(encoded[i + 1])];
+            uint8_t low = HEX_VALUES[static_cast<unsigned char>(encoded[i + 2])];
+            if (high != NOT_HEX && low != NOT_HEX) {
+                out += static_cast<char>(high << 4 | low);
+                i += 2;
+                continue;
+            }
+        }
+        out += plus_as_space && c == '+' ? ' ' : c;
+    }
+}
+
+std::optional<std::string_view> PathParams::get(std::string_view name) const {
+    for (const auto& [key, value] : *this) {
+        if (key == name) {
+            return value;
+        }
+    }
+    return std::nullopt;
+}
+
+QueryParams::QueryParams(const QueryParams& other): query_(other.query_) {}
+
+QueryParams& QueryParams::operator=(const QueryParams& other) {
+    if (this != &other) {
+        assign(other.query_);
+    }
+    return *this;
+}
+
+void QueryParams::assign(std::string_view query) {
+    query_ = query;
+    split_ = false;
+}
+
+void QueryParams::clear() {
+    assign({});
+}
+
+std::optional<std::string_view> QueryParams::get(std::string_view key) const {
+    std::optional<std::string_view> found;
+    for (const auto& [name, value] : *this) {
+        if (name == key) {
+            found = value;
+        }
+    }
+    return found;
+}
+
+size_t QueryParams::size() const {
+    split();
+    return items_.size();
+}
+
+const RequestParam* QueryParams::begin() const {
+    split();
+    return items_.begin();
+}
+
+const RequestParam* QueryParams::end() const {
+    split();
+    return items_.end();
+}
+
+void QueryParams::split() const {
+    if (split_) {
+        return;
+    }
+    split_ = true;
+    items_.clear();
+    decoded_.clear();
+    std::string_view rest = query_;
+    while (!rest.empty()) {
+        size_t amp_pos = rest.find('&');
+        std::string_view pair = rest.substr(0, amp_pos);
+        rest.remove_prefix(amp_pos == std::string_view::npos ? rest.size() : amp_pos + 1);
+        if (pair.empty()) {
+            continue;
+        }
+        size_t eq_pos = pair.find('=');
+        RequestParam& param = items_.emplace_back();
+        param.first = decode(pair.substr(0, eq_pos));
+        param.second = eq_pos != std::string_view::npos ? decode(pair.substr(eq_pos + 1)) : std::string_view{};
+    }
+}
+
+std::string_view QueryParams::decode(std::string_view encoded) const {
+    if (!needs_decoding(encoded)) {
+        return encoded;
+    }
+    // Decoding never lengthens the text, so with room for the whole query the
+    // buffer is not reallocated under views handed out earlier.
+    if (decoded_.capacity() < query_.size()) {
+        decoded_.reserve(query_.size());
+    }
+    size_t start = decoded_.size();
+    append_url_decoded(decoded_, encoded, true);
+    return std::string_view(decoded_).substr(start);
+}
@@ -0,0 +1,164 @@
+#include "../include/response_cache.hpp"
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace {
+
+uint64_t fnv1a(std::string_view data, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c: data) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+ResponseCache::ResponseCache(size_t capacity_bytes): shard_capacity(capacity_bytes / SHARD_COUNT) {}
+
+std::string ResponseCache::make_key(const HttpRequest& request, const std::vector<std::string>& key_headers) {
+    // Decoded values may contain any byte, so every piece is length-prefixed.
+    std::string key = std::to_string(static_cast<int>(request.method));
+    key += ' ';
+    key += request.route;
+    // The last value of a repeated name wins, as in QueryParams::get. A stable sort
+    // keeps repeats in order, so the last of each run is the one kept.
+    std::vector<RequestParam> params(request.query_params.begin(), request.query_params.end());
+    std::stable_sort(params.begin(), params.end(), [](const RequestParam& a, const RequestParam& b) {
+        return a.first < b.first;
+    });
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (i + 1 < params.size() && params[i + 1].first == params[i].first) {
+            continue;
+        }
+        const auto& [name, value] = params[i];
+        key += std::format("\n{}:{}={}:{}", name.size(), name, value.size(), value);
+    }
+    for (const auto& name: key_headers) {
+        auto value = request.get_header(name);
+        key += value ? std::format("\n{}:{}", value->size(), *value) : std::string("\n-");
+    }
+    return key;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::serialize(HttpResponse& response) {
+    uint64_t hash = fnv1a("");
+    for (const auto& segment: response.body_segments()) {
+        if (segment.is_file()) {
+            return nullptr;
+        }
+        hash = fnv1a(segment.view(), hash);
+    }
+    auto cached = std::make_shared<CachedResponse>();
+    cached->status = response.get_status().get_status();
+    cached->cacheable = cached->status == HttpStatusCode::OK &&
+        response.get_header(KnownHeader::CacheControl).value_or("").find("no-store") == std::string::npos;
+    if (cached->status == HttpStatusCode::OK && !response.get_header(KnownHeader::ETag).has_value()) {
+        response.set_header(KnownHeader::ETag, std::format("\"{:016x}\"", hash));
+    }
+    cached->etag = response.get_header(KnownHeader::ETag).value_or("");
+    cached->last_modified = response.get_header(KnownHeader::LastModified).value_or("");
+
+    // Written on every send instead; a stored Date would go stale.
+    response.remove_header(KnownHeader::Date);
+    response.remove_header(KnownHeader::Connection);
+    cached->own_server = response.get_header(KnownHeader::Server).has_value();
+
+    std::string wire;
+    response.serialize_head(wire);
+    cached->status_line_size = wire.find("\r\n") + 2;
+    for (const auto& segment: response.body_segments()) {
+        wire += segment.view();
+    }
+    cached->wire = std::make_shared<const std::string>(std::move(wire));
+    return cached;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::find(const std::string& key) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    if (std::chrono::steady_clock::now() >= it->second->expires) {
+        erase(shard, it->second);
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second->response;
+}
+
+void ResponseCache::insert(const std::string& key, std::shared_ptr<const CachedResponse> response,
+                           std::chrono::milliseconds ttl) {
+    size_t limit = shard_capacity.load(std::memory_order_relaxed);
+    size_t bytes = response->wire->size() + key.size();
+    if (!response->cacheable || bytes > limit) {
+        return;
+    }
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        erase(shard, it->second);
+    }
+    evict_to(shard, limit - bytes);
+    shard.lru.push_front(Entry{key, std::move(response), std::chrono::steady_clock::now() + ttl, bytes});
+    shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+    shard.bytes += bytes;
+}
+
+void ResponseCache::set_capacity(size_t capacity_bytes) {
+    size_t limit = capacity_bytes / SHARD_COUNT;
+    shard_capacity.store(limit, std::memory_order_relaxed);
+    for (Shard& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        evict_to(shard, limit);
+    }
+}
+
+void ResponseCache::clear() {
+    for (Shard& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+ResponseCacheStats ResponseCache::get_stats() const {
+    size_t bytes = 0;
+    for (const Shard& shard: shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        bytes += shard.bytes;
+    }
+    return ResponseCacheStats{
+        hits.load(std::memory_order_relaxed),
+        misses.load(std::memory_order_relaxed),
+        evictions.load(std::memory_order_relaxed),
+        bytes
+    };
+}
+
+ResponseCache::Shard& ResponseCache::shard_for(const std::string& key) {
+    return shards[std::hash<std::string>{}(key) % SHARD_COUNT];
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->key);
+    shard.lru.erase(it);
+}
+
+void ResponseCache::evict_to(Shard& shard, size_t limit) {
+    while (shard.bytes > limit && !shard.lru.empty()) {
+        erase(shard, std::prev(shard.lru.end()));
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
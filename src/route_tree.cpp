@@ -0,0 +1,157 @@
+#include "../include/route_tree.hpp"
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+
+RouteTree::RouteTree(): root(std::make_unique<Node>()) {
+    root->kind = NodeKind::STATIC;
+}
+
+RouteTree::Route& RouteTree::insert(const std::string& pattern, RouteHandler handler, const RouteOptions& options) {
+    // Validate the whole pattern before touching the tree so a rejected route
+    // leaves no parameter nodes behind.
+    struct Token {
+        NodeKind kind;
+        std::string_view text;
+    };
+    std::vector<Token> tokens;
+    std::string_view rest(pattern);
+    size_t param_count = 0;
+    size_t pos = 0;
+    while (pos < rest.size()) {
+        size_t open = rest.find('{', pos);
+        if (open == std::string_view::npos) {
+            tokens.push_back({NodeKind::STATIC, rest.substr(pos)});
+            break;
+        }
+        if (open > pos) {
+            tokens.push_back({NodeKind::STATIC, rest.substr(pos, open - pos)});
+        }
+        size_t close = rest.find('}', open);
+        if (close == std::string_view::npos) {
+            throw std::invalid_argument(std::format("route '{}': unterminated parameter", pattern));
+        }
+        std::string_view name = rest.substr(open + 1, close - open - 1);
+        bool catch_all = name.ends_with("...");
+        if (catch_all) {
+            name.remove_suffix(3);
+        }
+        if (name.empty() || name.find_first_of("{/") != std::string_view::npos) {
+            throw std::invalid_argument(std::format("route '{}': invalid parameter name", pattern));
+        }
+        bool starts_segment = open > 0 && rest[open - 1] == '/';
+        bool ends_segment = close + 1 == rest.size() || rest[close + 1] == '/';
+        if (!starts_segment || !ends_segment) {
+            throw std::invalid_argument(std::format("route '{}': parameters must span a whole segment", pattern));
+        }
+        if (catch_all && close + 1 != rest.size()) {
+            throw std::invalid_argument(std::format("route '{}': {{{}...}} must be the last segment", pattern, name));
+        }
+        if (++param_count > PathParams::MAX_PARAMS) {
+            throw std::invalid_argument(std::format("route '{}': more than {} parameters", pattern, PathParams::MAX_PARAMS));
+        }
+        tokens.push_back({catch_all ? NodeKind::CATCH_ALL : NodeKind::PARAM, name});
+        pos = close + 1;
+    }
+
+    Node* node = root.get();
+    for (const Token& token : tokens) {
+        if (token.kind == NodeKind::STATIC) {
+            node = insert_static(node, token.text);
+            continue;
+        }
+        std::unique_ptr<Node>& slot = token.kind == NodeKind::CATCH_ALL ? node->catch_all_child : node->param_child;
+        if (!slot) {
+            slot = std::make_unique<Node>();
+            slot->kind = token.kind;
+            slot->label = token.text;
+        } else if (slot->label != token.text) {
+            throw std::invalid_argument(std::format(
+                "route '{}': parameter {{{}}} conflicts with {{{}}} already registered at the same position",
+                pattern, token.text, slot->label));
+        }
+        node = slot.get();
+    }
+
+    if (node->route) {
+        throw std::invalid_argument(std::format("route '{}' conflicts with existing route '{}'", pattern, node->route->pattern));
+    }
+    node->route = std::make_unique<Route>(Route{pattern, std::move(handler), options, std::nullopt});
+    return *node->route;
+}
+
+RouteTree::Node* RouteTree::insert_static(Node* node, std::string_view text) {
+    while (!text.empty()) {
+        auto it = std::find_if(node->children.begin(), node->children.end(),
+            [&](const auto& child) { return child->label.front() == text.front(); });
+        if (it == node->children.end()) {
+            auto child = std::make_unique<Node>();
+            child->kind = NodeKind::STATIC;
+            child->label = text;
+            node->children.push_back(std::move(child));
+            return node->children.back().get();
+        }
+
+        std::unique_ptr<Node>& child = *it;
+        size_t common = 0;
+        size_t limit = std::min(child->label.size(), text.size());
+        while (common < limit && child->label[common] == text[common]) {
+            ++common;
+        }
+        if (common < child->label.size()) {
+            // Split the edge: the shared prefix becomes a new node above the old child.
+            auto split = std::make_unique<Node>();
+            split->kind = NodeKind::STATIC;
+            split->label = child->label.substr(0, common);
+            child->label.erase(0, common);
+            split->children.push_back(std::move(child));
+            child = std::move(split);
+        }
+        node = child.get();
+        text.remove_prefix(common);
+    }
+    return node;
+}
+
+const RouteTree::Route* RouteTree::find(std::string_view path, PathParams& captures) const {
+    captures.clear();
+    return match(root.get(), path, captures);
+}
+
+const RouteTree::Route* RouteTree::match(const Node* node, std::string_view path, PathParams& captures) {
+    if (path.empty() && node->route) {
+        return node->route.get();
+    }
+
+    if (!path.empty()) {
+        for (const auto& child : node->children) {
+            if (child->label.front() != path.front()) {
+                continue;
+            }
+            if (path.starts_with(child->label)) {
+                if (const Route* found = match(child.get(), path.substr(child->label.size()), captures)) {
+                    return found;
+                }
+            }
+            break;
+        }
+    }
+
+    if (node->param_child) {
+        size_t segment_end = std::min(path.find('/'), path.size());
+        if (segment_end > 0) {
+            size_t mark = captures.size_;
+            captures.items_[captures.size_++] = {node->param_child->label, path.substr(0, segment_end)};
+            if (const Route* found = match(node->param_child.get(), path.substr(segment_end), captures)) {
+                return found;
+            }
+            captures.size_ = mark;
+        }
+    }
+
+    if (node->catch_all_child && node->catch_all_child->route) {
+        captures.items_[captures.size_++] = {node->catch_all_child->label, path};
+        return node->catch_all_child->route.get();
+    }
+    return nullptr;
+}
@@ -1,107 +1,188 @@
 #include "../include/router.hpp"
-#include <functional>
-#include <optional>
-#include <sstream>
+#include "../include/conditional_request.hpp"
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-size_t RouteHash::operator()(const std::pair<RequestMethod, std::string>& pair) const  {
-    size_t h1 = std::hash<int>{}(static_cast<int>(pair.first));
-    size_t h2 = std::hash<std::string>{}(pair.second);
-    return h1 ^ (h2 << 1);
+namespace {
+
+// Stands in for the plain handler of a coroutine route, which the connection
+// never calls; reached only through get_route or match_route.
+HttpResponse async_only(const HttpRequest&) {
+    HttpResponse response;
+    response.set_status(HttpStatusCode::InternalServerError);
+    response.set_content_type(MimeType::TextPlain);
+    response.set_body("Route is served by a coroutine handler");
+    return response;
 }
 
-RoutePattern::RoutePattern(const std::string& pattern, std::function<HttpResponse(const HttpRequest&)>& handler): original_pattern(pattern), handler(handler) {
-    parse_pattern(pattern);
 }
 
-void RoutePattern::parse_pattern(const std::string& pattern) {
-    std::istringstream ss(pattern);
-    std::string segment;
-    while(std::getline(ss, segment, '/')) {
-        if(segment.empty()) continue;
-        segments.push_back(segment);
-        if(is_param_segment(segment)) {
-            param_names.push_back(extract_param_name(segment));
-        }
+const RouteHandler* Router::match_route(RequestMethod method, std::string_view path, HttpRequest& request) const {
+    const RouteTree::Route* matched = match(method, path, request);
+    return matched != nullptr ? &matched->handler : nullptr;
+}
+
+const RouteTree::Route* Router::match(RequestMethod method, std::string_view path, HttpRequest& request) const {
+    auto tree_it = routes.find(method);
+    if (tree_it == routes.end()) {
+        return nullptr;
     }
+    return tree_it->second.find(path, request.path_params);
 }
 
-bool RoutePattern::is_param_segment(const std::string& segment) const {
-    return segment.size() >= 3 && segment.front() == '{' && segment.back() == '}';
+RouteTree::Route& Router::insert(RequestMethod method, const std::string& route, RouteHandler handler,
+                                 const RouteOptions& options) {
+    RouteTree::Route& added = routes[method].insert(route, std::move(handler), options);
+    added.id = registered.size();
+    registered.emplace_back(method, route);
+    return added;
 }
 
-std::string RoutePattern::extract_param_name(const std::string& segment) const {
-    return segment.substr(1, segment.size() - 2);
+void Router::add_route(RequestMethod method, const std::string& route, RouteHandler handler,
+                       const RouteOptions& options) {
+    insert(method, route, std::move(handler), options);
+    blocking_routes = blocking_routes || options.blocking;
 }
 
-bool RoutePattern::matches(const std::string& path, std::map<std::string, std::string>& params) const {
-    std::vector<std::string> path_segments;
-    std::istringstream ss(path);
-    std::string segment;
-    while(std::getline(ss, segment, '/')) {
-        if(segment.empty()) continue;
-        path_segments.push_back(segment);
+void Router::add_async_route(RequestMethod method, const std::string& route, AsyncRouteHandler handler) {
+    RouteTree::Route& added = insert(method, route, RouteHandler::bind<&async_only>(), {});
+    added.async_handler.emplace(std::move(handler));
+}
+
+const std::vector<route>& Router::get_routes() const {
+    return registered;
+}
+
+bool Router::has_blocking_routes() const {
+    return blocking_routes;
+}
+
+RouteReply Router::dispatch(const RouteTree::Route& route, HttpRequest& request, bool wait) {
+    RouteReply reply;
+    if (!serve_shared(route, request, reply, wait)) {
+        reply.response = route.handler(request);
+        apply_conditional_request(request, reply.response);
+    }
+    return reply;
+}
+
+void Router::finish_joined(const RouteTree::Route& route, HttpRequest& request, RouteReply& reply) {
+    std::shared_ptr<const CachedResponse> shared = reply.joined->result();
+    reply.joined.reset();
+    if (!shared) {
+        // The leader's response could not be shared, so this request runs the handler.
+        shared = produce_shared(route, request, ResponseCache::make_key(request, route.options.key_headers), reply);
+    }
+    reply_shared(request, std::move(shared), reply);
+}
+
+bool Router::serve_shared(const RouteTree::Route& route, HttpRequest& request, RouteReply& reply, bool wait) {
+    const RouteOptions& options = route.options;
+    bool caching = options.cache_ttl.count() > 0;
+    if (!caching && !options.coalesce) {
+        return false;
+    }
+    // Ranges are cut from a fresh response rather than from the shared bytes.
+    bool shareable = request.method == RequestMethod::GET || request.method == RequestMethod::HEAD;
+    if (!shareable || request.get_header(KnownHeader::Range).has_value()) {
+        return false;
     }
-    if(path_segments.size() != segments.size()) return false;
-    size_t param_index = 0;
-    for(size_t i = 0; i < segments.size(); ++i) {
-        if(is_param_segment(segments[i])) {
-            if(param_index < segments.size()) {
-                params[param_names[param_index]] = path_segments[i];
-                param_index++;
-            } else {
-                if (segments[i] != path_segments[i]) {
-                    return false;
-                }
+    std::string key = ResponseCache::make_key(request, options.key_headers);
+    std::shared_ptr<const CachedResponse> shared;
+    if (caching) {
+        shared = response_cache.find(key);
+    }
+    if (!shared) {
+        auto produce = [&]() {
+            return produce_shared(route, request, key, reply);
+        };
+        if (options.coalesce) {
+            RequestCoalescer::Outcome outcome = coalescer.run(key, produce, wait);
+            if (outcome.joined) {
+                reply.joined = std::move(outcome.joined);
+                return true;
+            }
+            shared = outcome.response;
+            if (!shared && !outcome.leader) {
+                shared = produce();
             }
+        } else {
+            shared = produce();
         }
     }
+    reply_shared(request, std::move(shared), reply);
     return true;
 }
 
-std::optional<std::function<HttpResponse(const HttpRequest&)>> Router::match_route(RequestMethod method, const std::string& path, HttpRequest& request) {
-    auto exact_key = std::make_pair(method, path);
-    auto exact_it = exact_routes.find(exact_key);
-    if (exact_it != exact_routes.end()) {
-        request.path_params.clear();
-        return exact_it->second;
-    }
-    auto param_it = param_routes.find(method);
-    if (param_it != param_routes.end()) {
-        for (const auto& route_pattern : param_it->second) {
-            std::map<std::string, std::string> path_params;
-            if (route_pattern.matches(path, path_params)) {
-                request.path_params = std::move(path_params);
-                return route_pattern.handler;
-            }
-        }
+std::shared_ptr<const CachedResponse> Router::produce_shared(const RouteTree::Route& route, HttpRequest& request,
+                                                             const std::string& key, RouteReply& reply) {
+    reply.response = route.handler(request);
+    std::shared_ptr<const CachedResponse> serialized = ResponseCache::serialize(reply.response);
+    if (serialized && route.options.cache_ttl.count() > 0) {
+        response_cache.insert(key, serialized, route.options.cache_ttl);
     }
-    return std::nullopt;
+    return serialized;
 }
 
-void Router::add_route(RequestMethod method, const std::string& route, std::function<HttpResponse(const HttpRequest&)> handler) {
-    if(has_parameters(route)) {
-        param_routes[method].emplace_back(route, handler);
-    } else {
-        exact_routes.emplace(std:: make_pair(method, route), handler);
+void Router::reply_shared(HttpRequest& request, std::shared_ptr<const CachedResponse> shared, RouteReply& reply) {
+    if (!shared) {
+        // A response that could not be shared, already in reply.response.
+        apply_conditional_request(request, reply.response);
+        return;
+    }
+    bool fresh = shared->status == HttpStatusCode::OK &&
+                 is_not_modified(request, shared->etag, shared->last_modified);
+    if (!fresh) {
+        reply.shared = std::move(shared);
+        return;
     }
+    reply.response = HttpResponse();
+    reply.response.set_status(HttpStatusCode::NotModified);
+    if (!shared->etag.empty()) {
+        reply.response.set_header(KnownHeader::ETag, shared->etag);
+    }
+    if (!shared->last_modified.empty()) {
+        reply.response.set_header(KnownHeader::LastModified, shared->last_modified);
+    }
+}
+
+ResponseCache& Router::get_response_cache() {
+    return response_cache;
 }
 
-std::optional<routes_iterator> Router::get_route(route route) {
+RequestCoalescer& Router::get_coalescer() {
+    return coalescer;
+}
+
+void Router::add_static(const std::string& prefix, const std::string& root, const StaticFilesConfig& config) {
+    // One engine, and so one descriptor cache, shared by the GET and HEAD routes.
+    auto files = std::make_shared<const StaticFiles>(root, config);
+    std::string pattern = prefix;
+    if (pattern.empty() || pattern.back() != '/') {
+        pattern += '/';
+    }
+    pattern += "{path...}";
+    auto serve = [files](const HttpRequest& request) { return (*files)(request); };
+    add_route(RequestMethod::GET, pattern, serve);
+    add_route(RequestMethod::HEAD, pattern, serve);
+}
+
+const RouteHandler* Router::get_route(route route) const {
     if (route.second.find('?') != std::string::npos) {
         route.second =  route.second.substr(0, route.second.find('?'));
     }
-    auto it = exact_routes.find(route);
-    if (it == exact_routes.end()) {
-        return std::nullopt;
+    auto tree_it = routes.find(route.first);
+    if (tree_it == routes.end()) {
+        return nullptr;
     }
-    return std::make_optional(it);
-}
-
-bool Router::has_parameters(const std::string& route_pattern) {
-    return route_pattern.find('{') != std::string::npos && 
-        route_pattern.find('}') != std::string::npos; 
+    // A pattern matches itself, with each parameter capturing its own placeholder.
+    PathParams captures;
+    const RouteTree::Route* matched = tree_it->second.find(route.second, captures);
+    if (matched == nullptr || matched->pattern != route.second) {
+        return nullptr;
+    }
+    return &matched->handler;
 }
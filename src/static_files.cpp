@@ -0,0 +1,86 @@
+#include "../include/static_files.hpp"
+#include <string>
+
+StaticFiles::StaticFiles(std::string root, const StaticFilesConfig& config)
+    : root(std::move(root)), index_file(config.index_file), cache(config.cache_ttl, config.max_open_files) {
+    while (this->root.size() > 1 && this->root.back() == '/') {
+        this->root.pop_back();
+    }
+}
+
+HttpResponse StaticFiles::operator()(const HttpRequest& request) const {
+    HttpResponse response;
+    std::string relative = decode_path(request.get_path_param("path").value_or(""));
+    std::shared_ptr<const OpenFile> file;
+    if (is_safe_path(relative)) {
+        file = find_file(relative);
+        if (!file && is_directory_index(relative)) {
+            // Redirect so the index is served under its own URL: its relative links
+            // resolve against the directory and its type comes from the index file.
+            std::string_view query = request.full_route.substr(request.route.size());
+            response.set_status(HttpStatusCode::MovedPermanently);
+            response.set_header(KnownHeader::Location, std::string(request.route) + "/" + std::string(query));
+            return response;
+        }
+    }
+    if (!file) {
+        response.set_status(HttpStatusCode::NotFound);
+        response.set_content_type(MimeType::TextPlain);
+        response.set_body("File not found");
+        return response;
+    }
+
+    response.set_status(HttpStatusCode::OK);
+    response.set_content_type(mime_type_from_path(relative.empty() || relative.back() == '/' ? index_file : relative));
+    response.set_header(KnownHeader::LastModified, file->last_modified);
+    response.set_header(KnownHeader::ETag, file->etag);
+    response.set_header(KnownHeader::AcceptRanges, "bytes");
+    if (request.method == RequestMethod::HEAD) {
+        response.set_header(KnownHeader::ContentLength, std::to_string(file->size));
+    } else {
+        uint64_t size = file->size;
+        response.append_body(BodySegment(std::move(file), 0, size));
+    }
+    return response;
+}
+
+std::shared_ptr<const OpenFile> StaticFiles::find_file(const std::string& relative) const {
+    std::string path = root + "/" + relative;
+    if (!relative.empty() && relative.back() != '/') {
+        return cache.open(path);
+    }
+    if (index_file.empty()) {
+        return nullptr;
+    }
+    return cache.open(path + index_file);
+}
+
+bool StaticFiles::is_directory_index(const std::string& relative) const {
+    if (relative.empty() || relative.back() == '/' || index_file.empty()) {
+        return false;
+    }
+    return cache.open(root + "/" + relative + "/" + index_file) != nullptr;
+}
+
+bool StaticFiles::is_safe_path(std::string_view path) {
+    if (path.find('\0') != std::string_view::npos) {
+        return false;
+    }
+    while (!path.empty()) {
+        size_t slash = path.find('/');
+        std::string_view segment = path.substr(0, slash);
+        if (segment == "..") {
+            return false;
+        }
+        path.remove_prefix(slash == std::string_view::npos ? path.size() : slash + 1);
+    }
+    return true;
+}
+
+std::string StaticFiles::decode_path(std::string_view encoded) {
+    // Percent-decoding only: unlike a query string, '+' in a path is literal.
+    std::string decoded;
+    decoded.reserve(encoded.size());
+    append_url_decoded(decoded, encoded, false);
+    return decoded;
+}
@@ -0,0 +1,110 @@
+#include "../include/timer_wheel.hpp"
+#include <bit>
+
+TimerWheel::TimerWheel(uint64_t tick_ms, uint64_t now_ms)
+    : tick_ms(tick_ms), current_tick(now_ms / tick_ms), count(0), wheels{}, occupied{} {}
+
+size_t TimerWheel::size() const {
+    return count;
+}
+
+void TimerWheel::arm(TimerNode& node, uint64_t expires_ms) {
+    if (node.armed) {
+        unlink(node);
+    }
+    uint64_t expires_tick = (expires_ms + tick_ms - 1) / tick_ms;
+    node.expires_tick = expires_tick > current_tick ? expires_tick : current_tick + 1;
+    insert(node);
+}
+
+void TimerWheel::cancel(TimerNode& node) {
+    if (node.armed) {
+        unlink(node);
+    }
+}
+
+void TimerWheel::insert(TimerNode& node) {
+    // Pick the finest level whose slot for this expiry lies within one revolution.
+    unsigned level = 0;
+    while (level < LEVELS - 1 &&
+           (node.expires_tick >> (SLOT_BITS * level)) - (current_tick >> (SLOT_BITS * level)) >= SLOTS) {
+        ++level;
+    }
+    uint64_t slot_index = node.expires_tick >> (SLOT_BITS * level);
+    if (slot_index - (current_tick >> (SLOT_BITS * level)) >= SLOTS) {
+        // Beyond the top level's reach: park in its last slot and cascade again later.
+        slot_index = (current_tick >> (SLOT_BITS * level)) + SLOTS - 1;
+    }
+    node.level = static_cast<uint8_t>(level);
+    node.slot = static_cast<uint8_t>(slot_index & (SLOTS - 1));
+
+    Slot& slot = wheels[level][node.slot];
+    node.prev = nullptr;
+    node.next = slot.head;
+    if (slot.head != nullptr) {
+        slot.head->prev = &node;
+    }
+    slot.head = &node;
+    occupied[level] |= uint64_t(1) << node.slot;
+    node.armed = true;
+    ++count;
+}
+
+void TimerWheel::unlink(TimerNode& node) {
+    Slot& slot = wheels[node.level][node.slot];
+    if (node.prev != nullptr) {
+        node.prev->next = node.next;
+    } else {
+        slot.head = node.next;
+    }
+    if (node.next != nullptr) {
+        node.next->prev = node.prev;
+    }
+    if (slot.head == nullptr) {
+        occupied[node.level] &= ~(uint64_t(1) << node.slot);
+    }
+    node.prev = nullptr;
+    node.next = nullptr;
+    node.armed = false;
+    --count;
+}
+
+void TimerWheel::cascade(unsigned level) {
+    Slot& slot = wheels[level][(current_tick >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    TimerNode* node = slot.head;
+    slot.head = nullptr;
+    occupied[level] &= ~(uint64_t(1) << ((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1)));
+    while (node != nullptr) {
+        TimerNode* next = node->next;
+        --count;
+        insert(*node);
+        node = next;
+    }
+}
+
+int TimerWheel::next_timeout_ms(uint64_t now_ms) const {
+    if (count == 0) {
+        return -1;
+    }
+    uint64_t earliest_tick = UINT64_MAX;
+    for (unsigned level = 0; level < LEVELS; ++level) {
+        if (occupied[level] == 0) {
+            continue;
+        }
+        // First occupied slot after the current one, in wheel order.
+        unsigned shift = SLOT_BITS * level;
+        unsigned current_slot = (current_tick >> shift) & (SLOTS - 1);
+        uint64_t rotated = std::rotr(occupied[level], static_cast<int>((current_slot + 1) & (SLOTS - 1)));
+        uint64_t distance = static_cast<uint64_t>(std::countr_zero(rotated)) + 1;
+        uint64_t slot_start = ((current_tick >> shift) + distance) << shift;
+        if (slot_start < earliest_tick) {
+            earliest_tick = slot_start;
+        }
+    }
+    uint64_t earliest_ms = earliest_tick * tick_ms;
+    if (earliest_ms <= now_ms) {
+        return 0;
+    }
+    uint64_t wait = earliest_ms - now_ms;
+    return wait > INT32_MAX ? INT32_MAX : static_cast<int>(wait);
+}
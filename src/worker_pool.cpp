@@ -0,0 +1,121 @@
+#include "../include/worker_pool.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <exception>
+
+WorkerPool::WorkerPool(Router& router, size_t threads): router(router) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i]() { run(i); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mtx);
+        stopping = true;
+    }
+    idle_cv.notify_all();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::submit(std::unique_ptr<DeferredRequest> job) {
+    job->queued = std::chrono::steady_clock::now();
+    submitted.fetch_add(1, std::memory_order_relaxed);
+    {
+        // Counted before the push so a worker never takes a job it has not seen
+        // counted; the lock keeps the increment from landing between a worker's
+        // check and its wait.
+        std::lock_guard<std::mutex> lock(idle_mtx);
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    Queue& queue = *queues[next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        queue.jobs.push_back(std::move(job));
+    }
+    idle_cv.notify_one();
+}
+
+WorkerPoolStats WorkerPool::get_stats() const {
+    return WorkerPoolStats{
+        queued.load(std::memory_order_relaxed),
+        submitted.load(std::memory_order_relaxed),
+        completed.load(std::memory_order_relaxed),
+        total_wait_us.load(std::memory_order_relaxed),
+        max_wait_us.load(std::memory_order_relaxed)
+    };
+}
+
+void WorkerPool::run(size_t index) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(idle_mtx);
+            idle_cv.wait(lock, [this]() { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+        std::unique_ptr<DeferredRequest> job = take(index);
+        if (!job) {
+            // Another worker took it, or the job is counted but not yet pushed.
+            std::this_thread::yield();
+            continue;
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - job->queued).count();
+        total_wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+        uint64_t max_wait = max_wait_us.load(std::memory_order_relaxed);
+        while (wait_us > max_wait && !max_wait_us.compare_exchange_weak(max_wait, wait_us, std::memory_order_relaxed)) {}
+
+        try {
+            job->reply = router.dispatch(*job->route, job->request);
+        } catch (const std::exception& e) {
+            Logger::get_instance().error("Handler for {} failed: {}", job->request.route, e.what());
+            set_internal_error(job->reply);
+        } catch (...) {
+            Logger::get_instance().error("Handler for {} failed", job->request.route);
+            set_internal_error(job->reply);
+        }
+        completed.fetch_add(1, std::memory_order_relaxed);
+        EventLoop* loop = job->loop;
+        loop->complete_deferred(std::move(job));
+    }
+}
+
+void WorkerPool::set_internal_error(RouteReply& reply) {
+    // The job still goes back to its loop, so the connection is not left awaiting it.
+    reply.shared = nullptr;
+    reply.response.set_status(HttpStatusCode::InternalServerError);
+    reply.response.set_content_type(MimeType::TextPlain);
+    reply.response.set_body("Internal server error");
+}
+
+std::unique_ptr<DeferredRequest> WorkerPool::take(size_t index) {
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.jobs.empty()) {
+            auto job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            return job;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.jobs.empty()) {
+            auto job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            return job;
+        }
+    }
+    return nullptr;
+}